@@ -38,6 +38,13 @@ public:
     int maxStreams() const { return m_maxStreams; }
     void setMaxStreams(int streams);
     
+    // Binary upgrade handoff; an empty path disables it
+    QString upgradeSocket() const { return m_upgradeSocket; }
+    void setUpgradeSocket(const QString& path);
+    
+    bool upgradeHandoffListeners() const { return m_upgradeHandoffListeners; } // pass idle listeners along too
+    void setUpgradeHandoffListeners(bool enabled);
+    
     // Stream configuration
     int defaultLatency() const { return m_defaultLatency; }
     void setDefaultLatency(int latency);
@@ -106,6 +113,12 @@ public:
     int hlsPlaylistSize() const { return m_hlsPlaylistSize; }
     void setHlsPlaylistSize(int size);
     
+    QString hlsContainer() const { return m_hlsContainer; } // "packed" or "cmaf"
+    void setHlsContainer(const QString& container);
+    
+    bool hlsPersistSegments() const { return m_hlsPersistSegments; } // mirror HLS output to disk
+    void setHlsPersistSegments(bool enabled);
+    
     // Codec configuration
     QStringList enabledCodecs() const { return m_enabledCodecs; }
     void setEnabledCodecs(const QStringList& codecs);
@@ -230,6 +243,9 @@ public:
     QString getMountPointFallbackFile(const QString& mountPoint) const;
     void setMountPointFallbackFile(const QString& mountPoint, const QString& file);
     
+    int getMountPointDvrWindow(const QString& mountPoint) const; // seconds, 0 for none
+    void setMountPointDvrWindow(const QString& mountPoint, int seconds);
+    
     bool getMountPointEnabled(const QString& mountPoint) const;
     void setMountPointEnabled(const QString& mountPoint, bool enabled);
 
@@ -258,6 +274,8 @@ private:
     QHostAddress m_bindAddress = QHostAddress::Any;
     int m_maxConnections = 100000;
     int m_maxStreams = 1000;
+    QString m_upgradeSocket;
+    bool m_upgradeHandoffListeners = true;
     
     // Stream settings
     int m_defaultLatency = 5;
@@ -289,6 +307,8 @@ private:
     bool m_hlsEnabled = true;
     int m_hlsSegmentDuration = 6;
     int m_hlsPlaylistSize = 6;
+    QString m_hlsContainer = "packed";
+    bool m_hlsPersistSegments = false;
     
     // Codecs
     QStringList m_enabledCodecs = {"mp3", "aac", "aac+", "ogg", "opus", "flac"};
@@ -335,7 +355,7 @@ private:
     QString m_theme = "dark";
     
     // Mount points
-    QMap<QString, QMap<QString, QVariant>> m_mountPoints; // { mountPoint: { "name": "...", "protocol": "...", "description": "...", "codec": "...", "bitrate": 128, "quality": "128k", "public": true, "maxListeners": 100, "fallbackFile": "...", "enabled": true } }
+    QMap<QString, QMap<QString, QVariant>> m_mountPoints; // { mountPoint: { "name": "...", "protocol": "...", "description": "...", "codec": "...", "bitrate": 128, "quality": "128k", "public": true, "maxListeners": 100, "fallbackFile": "...", "dvrWindow": 0, "enabled": true } }
     
     Q_DISABLE_COPY(Configuration)
 };
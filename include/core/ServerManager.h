@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QObject>
+#include <QSet>
 #include <QThread>
 #include <QTimer>
 #include <QNetworkAccessManager>
@@ -19,6 +20,7 @@ class RelayManager;
 class MetadataManager;
 class SSLManager;
 class HLSGenerator;
+class UpgradeHandoff;
 
 namespace StatisticRelay {
     class StatisticRelayManager;
@@ -50,6 +52,11 @@ public:
     bool startServers();
     void stopServers();
     void restartServers();
+
+    // Applies the configured mount points to the running server: new
+    // mounts are created, changed ones reconfigured in place and removed
+    // ones drained, without touching connected sources or listeners
+    void reloadMounts();
     
     // Statistics
     struct ServerStats {
@@ -83,10 +90,13 @@ signals:
     void streamDisconnected(const QString& mountPoint);
     void listenerConnected(const QString& mountPoint, const QString& clientIP);
     void listenerDisconnected(const QString& mountPoint, const QString& clientIP);
+    void upgradeCompleted(); // handed over to a new binary and drained; the process quits next
 
 private slots:
     void updateStats();
     void handleServerError(const QString& error);
+    void handOverToSuccessor();
+    void finishUpgrade();
 
 private:
     ServerManager();
@@ -94,6 +104,7 @@ private:
     
     void initializeComponents();
     void setupStatisticsTimer();
+    void takeOverFromPredecessor();
     
     std::atomic<bool> m_isRunning{false};
     std::atomic<bool> m_initialized{false};
@@ -117,6 +128,16 @@ private:
     
     // Statistics
     QTimer* m_statsTimer;
+
+    // Mount reload; a burst of configuration changes is applied once
+    QTimer* m_reloadTimer;
+    QSet<QString> m_configuredMounts;
+    static const int MOUNT_DRAIN_TIMEOUT = 30000; // ms
+
+    // Zero-downtime binary upgrade
+    std::unique_ptr<UpgradeHandoff> m_upgradeHandoff;
+    bool m_handedOver = false;
+    static const int UPGRADE_DRAIN_TIMEOUT = 60000; // ms
     ServerStats m_currentStats;
     qint64 m_startTime;
     
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class QSocketNotifier;
+
+namespace LegacyStream {
+
+/**
+ * @brief Passes a running server's sockets to its successor binary
+ *
+ * The running process listens on a Unix socket. A newly started process
+ * connects to it, and the old one answers with its listening socket, any
+ * idle listener connections and each mount's HLS timeline position, the
+ * descriptors travelling as SCM_RIGHTS. Only once the successor has
+ * acknowledged everything does the old process let go of them, close its
+ * Unix socket and drain; a successor that dies half way leaves the old
+ * process serving as before.
+ *
+ * Frames are a 32-bit big-endian length and a JSON body, with up to
+ * MAX_FDS_PER_FRAME descriptors attached to the length. All I/O is
+ * blocking with a timeout; a handoff moves a few kilobytes per thousand
+ * connections.
+ *
+ * Linux only; elsewhere listen() and receive() fail.
+ */
+class UpgradeHandoff : public QObject
+{
+    Q_OBJECT
+
+public:
+    // One established listener connection
+    struct Connection
+    {
+        qintptr descriptor = -1;
+        QString mountPoint;  // empty when no listener session was open
+        QByteArray pending;  // request bytes read but not handled yet
+        quint32 userAgentHash = 0;
+        qint64 connectTime = 0; // ms since epoch
+        qint64 bytesSent = 0;
+    };
+
+    // Where a mount's HLS timeline stood: the successor opens segment
+    // nextSequence at position seconds, after a discontinuity
+    struct Cursor
+    {
+        QString mountPoint;
+        qint64 nextSequence = 0;
+        double position = 0.0;
+    };
+
+    struct State
+    {
+        qintptr listener = -1;
+        QVector<Connection> connections;
+        QVector<Cursor> cursors;
+    };
+
+    explicit UpgradeHandoff(QObject* parent = nullptr);
+    ~UpgradeHandoff();
+
+    // Old process: accept successors on path. Emits upgradeRequested()
+    // when one connects; the owner answers with handOver().
+    bool listen(const QString& path);
+    void close();
+    bool isListening() const { return m_server >= 0; }
+
+    // Sends state to the waiting successor. Returns true once it has taken
+    // everything over; the caller must then stop using the descriptors
+    // (closing its copies is fine). On false nothing was taken.
+    bool handOver(const State& state);
+
+    // New process: takes over from the process listening on path. Returns
+    // false, with state untouched, when nobody is there or it failed.
+    static bool receive(const QString& path, State& state, QString* error = nullptr);
+
+    static const int TIMEOUT = 5000; // ms per blocking step
+    static const int MAX_FDS_PER_FRAME = 250;
+
+signals:
+    void upgradeRequested();
+    void error(const QString& error);
+
+private slots:
+    void onPeerConnected();
+
+private:
+    static bool sendFrame(int fd, const QByteArray& body, const QVector<int>& fds);
+    static bool receiveFrame(int fd, QByteArray& body, QVector<int>& fds);
+
+    QString m_path;
+    int m_server = -1;
+    int m_peer = -1; // successor being served
+    QSocketNotifier* m_notifier = nullptr;
+
+    Q_DISABLE_COPY(UpgradeHandoff)
+};
+
+} // namespace LegacyStream
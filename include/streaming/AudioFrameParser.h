@@ -0,0 +1,116 @@
+#ifndef AUDIOFRAMEPARSER_H
+#define AUDIOFRAMEPARSER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+namespace LegacyStream {
+
+/**
+ * @brief Compressed audio frame header details
+ */
+struct AudioFrameInfo
+{
+    qint64 length = 0;          // Total frame size in bytes
+    int samples = 0;            // Samples per channel
+    int sampleRate = 0;
+    int channels = 0;
+    int bitrate = 0;            // kbps (MP3 only, 0 for ADTS)
+    int headerBytes = 0;        // Header plus CRC and side info
+    double mainDataRatio = 1.0; // MP3: coded main-data bits / payload bits
+
+    double duration() const { return sampleRate > 0 ? static_cast<double>(samples) / sampleRate : 0.0; }
+};
+
+/**
+ * @brief Location of one packet starting in an Ogg page
+ */
+struct OggPacket
+{
+    qint64 offset = 0;     // from the start of the page
+    qint64 length = 0;
+    bool complete = true;  // false when it continues on the next page
+};
+
+/**
+ * @brief Header-only parser for MP3 and ADTS AAC frames and Ogg Opus pages
+ *
+ * Finds frame boundaries and reads the fields needed for segmenting,
+ * splicing and cheap silence detection without decoding any audio. For
+ * Ogg Opus the unit is the page; its duration is summed from the TOC
+ * byte of each packet starting in it.
+ */
+class AudioFrameParser
+{
+public:
+    enum class Codec
+    {
+        MP3,
+        AAC_ADTS,
+        OGG_OPUS,
+        UNKNOWN
+    };
+
+    enum class Result
+    {
+        Frame,        // info is filled in
+        NeedMoreData, // sync found but the header is incomplete
+        NoSync        // no valid header at this position
+    };
+
+    static Codec codecFromString(const QString& codec);
+
+    static Result parse(Codec codec, const uchar* data, qint64 available, AudioFrameInfo& info);
+    static Result parseMp3(const uchar* data, qint64 available, AudioFrameInfo& info);
+    static Result parseAdts(const uchar* data, qint64 available, AudioFrameInfo& info);
+    static Result parseOggOpus(const uchar* data, qint64 available, AudioFrameInfo& info);
+
+    // Packets of a whole Ogg page; a packet continued from the previous
+    // page is skipped unless includeContinued is set
+    static QVector<OggPacket> oggPackets(const uchar* page, qint64 length, bool includeContinued = false);
+    static bool isOggContinued(const uchar* page) { return page[5] & 1; }
+    static int opusPacketSamples(const uchar* packet, qint64 length); // at 48 kHz
+
+    // Offset of the next frame header at or after from, or -1. When the
+    // following header is inside the buffer it must also be valid, which
+    // rejects most false syncs inside ID3 tags and payload data.
+    static qint64 findFrameStart(Codec codec, const uchar* data, qint64 size, qint64 from = 0);
+};
+
+/**
+ * @brief Re-chunks a byte stream so every chunk holds whole frames only
+ *
+ * Bytes before the first valid header are dropped and a trailing partial
+ * frame is held back until the rest arrives, so two aligned streams can
+ * be spliced between any two chunks. Codecs the parser does not know are
+ * passed through unchanged.
+ */
+class AudioFrameAligner
+{
+public:
+    explicit AudioFrameAligner(AudioFrameParser::Codec codec = AudioFrameParser::Codec::UNKNOWN);
+
+    void setCodec(AudioFrameParser::Codec codec);
+    AudioFrameParser::Codec codec() const { return m_codec; }
+    void reset();
+
+    // Returns the complete frames now available, possibly none. When
+    // given, samples receives their total duration in samples per channel.
+    QByteArray push(const QByteArray& data, qint64* samples = nullptr);
+
+    bool isSynced() const { return m_synced; }
+    int pendingBytes() const { return m_pending.size(); }
+
+private:
+    static const int MAX_UNSYNCED_BYTES = 64 * 1024;
+
+    AudioFrameParser::Codec m_codec;
+    QByteArray m_pending;
+    bool m_synced = false;
+};
+
+} // namespace LegacyStream
+
+#endif // AUDIOFRAMEPARSER_H
@@ -13,6 +13,10 @@
 #include <QAudioOutput>
 #include <QAudioInput>
 #include <QAudioDeviceInfo>
+#include <memory>
+
+#include "streaming/LoudnessMeter.h"
+#include "streaming/Resampler.h"
 
 namespace LegacyStream {
 
@@ -80,6 +84,7 @@ struct AudioAnalysis
     QMap<int, double> mfcc; // Mel-frequency cepstral coefficients
     bool isClipping = false;
     double snr = 0.0; // Signal-to-noise ratio
+    LoudnessMeasurement loudness; // EBU R128 loudness and true peak
     QDateTime timestamp;
 };
 
@@ -149,12 +154,17 @@ public:
     // Audio analysis
     AudioAnalysis analyzeAudio(const QByteArray& audioData, const QString& streamId);
     QJsonObject getAnalysisJson(const AudioAnalysis& analysis) const;
+    LoudnessMeasurement getLoudness(const QString& streamId) const;
+    void resetLoudness(const QString& streamId);
     void startRealTimeAnalysis(const QString& streamId, bool enabled);
     bool isRealTimeAnalysisEnabled(const QString& streamId) const;
 
     // Format conversion
     QByteArray convertFormat(const QByteArray& audioData, const QString& fromFormat, 
                             const QString& toFormat, const AudioFormatInfo& targetFormat);
+    QByteArray convertStream(const QByteArray& audioData, const QString& streamId,
+                            const AudioFormatInfo& sourceFormat, const AudioFormatInfo& targetFormat);
+    QByteArray flushStreamConversion(const QString& streamId);
     AudioFormatInfo detectFormat(const QByteArray& audioData);
     QJsonObject getFormatInfoJson(const AudioFormatInfo& format) const;
     bool isFormatSupported(const QString& format) const;
@@ -213,11 +223,14 @@ private:
     QMap<int, double> calculateMFCC(const QByteArray& audioData);
     bool detectClipping(const QByteArray& audioData);
     double calculateSNR(const QByteArray& audioData);
+    LoudnessMeasurement updateLoudness(const QByteArray& audioData, const QString& streamId);
+    void checkLoudnessCompliance(const QString& streamId);
 
     // Utility functions
     QByteArray resampleAudio(const QByteArray& audioData, int fromSampleRate, int toSampleRate);
     QByteArray convertChannels(const QByteArray& audioData, int fromChannels, int toChannels);
     QByteArray convertBitDepth(const QByteArray& audioData, int fromBitDepth, int toBitDepth);
+    static PcmFormat toPcmFormat(const AudioFormatInfo& format);
     QString formatToString(AudioEffectType effect) const;
     AudioEffectType stringToFormat(const QString& format) const;
 
@@ -228,7 +241,7 @@ private:
 
     // State management
     QAtomicInt m_isRunning = 0;
-    QMutex m_mutex;
+    mutable QMutex m_mutex;
 
     // Effects and processing
     QMap<QString, QList<AudioFilterConfig>> m_streamEffects;
@@ -238,6 +251,7 @@ private:
     QMap<QString, bool> m_realTimeAnalysisEnabled;
     QMap<QString, AudioAnalysis> m_lastAnalysis;
     QMap<QString, QList<AudioAnalysis>> m_analysisHistory;
+    QMap<QString, std::shared_ptr<LoudnessMeter>> m_loudnessMeters;
 
     // Synchronization
     QMap<QString, AudioSyncInfo> m_syncInfo;
@@ -254,6 +268,9 @@ private:
     QMap<QString, int> m_effectApplications;
     QMap<QString, int> m_formatConversions;
 
+    // Format conversion state kept across chunks, one per transcoded stream
+    QMap<QString, std::shared_ptr<Resampler>> m_resamplers;
+
     // Audio devices
     QAudioDeviceInfo m_inputDevice;
     QAudioDeviceInfo m_outputDevice;
@@ -0,0 +1,70 @@
+#ifndef CMAFPACKAGER_H
+#define CMAFPACKAGER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "streaming/AudioFrameParser.h"
+
+namespace LegacyStream {
+
+/**
+ * @brief Codec setup of one CMAF audio track
+ *
+ * decoderConfig is the AudioSpecificConfig for AAC and the body of the
+ * dOps box for Opus; MP3 needs none.
+ */
+struct CMAFTrack
+{
+    AudioFrameParser::Codec codec = AudioFrameParser::Codec::UNKNOWN;
+    int sampleRate = 0; // also the media timescale
+    int channels = 0;
+    int preSkip = 0;    // Opus priming samples, trimmed by an edit list
+    QByteArray decoderConfig;
+
+    bool isValid() const { return codec != AudioFrameParser::Codec::UNKNOWN && sampleRate > 0 && channels > 0; }
+    QString codecsAttribute() const;
+
+    static CMAFTrack fromAdts(const uchar* header, int sampleRate, int channels);
+    static CMAFTrack fromMp3(int sampleRate, int channels);
+    static CMAFTrack fromOpusHead(const uchar* packet, qint64 length); // invalid on a bad header
+
+    bool operator==(const CMAFTrack& other) const
+    {
+        return codec == other.codec && sampleRate == other.sampleRate && channels == other.channels &&
+               preSkip == other.preSkip && decoderConfig == other.decoderConfig;
+    }
+    bool operator!=(const CMAFTrack& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Size and duration of one sample in a CMAF fragment
+ */
+struct CMAFSample
+{
+    quint32 size = 0;
+    quint32 duration = 0; // in track timescale units
+};
+
+/**
+ * @brief Writes ISO BMFF boxes for CMAF audio
+ *
+ * initSegment() gives the ftyp+moov written once per track setup;
+ * fragment() wraps samples in one moof+mdat. A segment is one or more
+ * fragments back to back, so LL-HLS parts and DASH chunks are simply
+ * the fragments of the segment being built.
+ */
+class CMAFPackager
+{
+public:
+    static QByteArray initSegment(const CMAFTrack& track);
+    static QByteArray fragment(quint32 sequenceNumber, quint64 baseMediaDecodeTime,
+                               const QVector<CMAFSample>& samples, const QByteArray& payload);
+
+    static const quint32 TRACK_ID = 1;
+};
+
+} // namespace LegacyStream
+
+#endif // CMAFPACKAGER_H
@@ -0,0 +1,132 @@
+#ifndef FALLBACKSOURCE_H
+#define FALLBACKSOURCE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include <memory>
+
+#include "streaming/AudioFrameParser.h"
+
+namespace LegacyStream {
+
+/**
+ * @brief One indexed frame of a fallback file
+ */
+struct FallbackFrame
+{
+    qint64 offset = 0;
+    qint64 length = 0;
+    qint64 timestamp = 0; // microseconds from the first frame
+};
+
+/**
+ * @brief Memory-mapped fallback file with a frame index built at load
+ *
+ * Files are shared: acquire() hands every caller asking for the same
+ * canonical path the same mapping and index, so an outage that drops
+ * every mount onto the emergency file maps it once. The file is reloaded
+ * when it changes on disk. Immutable after load, so safe to share across
+ * threads.
+ */
+class FallbackFile
+{
+public:
+    ~FallbackFile();
+
+    static std::shared_ptr<const FallbackFile> acquire(const QString& fileName, QString* error = nullptr);
+
+    QString fileName() const { return m_file.fileName(); }
+    const uchar* data() const { return m_data; }
+    qint64 size() const { return m_size; }
+
+    // Empty for codecs without a frame parser; those are paced by bitrate
+    const QVector<FallbackFrame>& frames() const { return m_frames; }
+    bool isIndexed() const { return !m_frames.isEmpty(); }
+    qint64 loopStart() const { return m_frames.isEmpty() ? 0 : m_frames.first().offset; }
+    qint64 duration() const { return m_duration; } // microseconds per loop
+    int sampleRate() const { return m_sampleRate; }
+    int channels() const { return m_channels; }
+
+private:
+    FallbackFile() = default;
+    bool load(const QString& fileName, QString* error);
+    void buildIndex(AudioFrameParser::Codec codec);
+
+    QFile m_file;
+    const uchar* m_data = nullptr;
+    qint64 m_size = 0;
+    QDateTime m_lastModified;
+
+    QVector<FallbackFrame> m_frames;
+    qint64 m_duration = 0;
+    int m_sampleRate = 0;
+    int m_channels = 0;
+
+    Q_DISABLE_COPY(FallbackFile)
+};
+
+/**
+ * @brief Looping file source used when a mount's live source fails
+ *
+ * Each mount gets its own cursor over a shared FallbackFile. Whole frames
+ * are released as their timestamps come due, and each chunk handed out is
+ * a QByteArray::fromRawData view into the mapping, so every listener of
+ * every mount reads the same pages. Files that could not be indexed are
+ * paced by the mount's bitrate instead.
+ */
+class FallbackSource : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FallbackSource(QObject* parent = nullptr);
+    ~FallbackSource();
+
+    bool open(const QString& fileName);
+    void close();
+    bool isOpen() const { return m_file != nullptr; }
+    QString fileName() const { return m_file ? m_file->fileName() : QString(); }
+
+    bool start(int bitrate);
+    void stop();
+    bool isRunning() const { return m_timer->isActive(); }
+
+signals:
+    void dataReady(const QByteArray& data);
+    void error(const QString& error);
+
+private slots:
+    void onTick();
+
+private:
+    void sendFrames(qint64 now);
+    void sendBytes(qint64 now);
+    void emitRange(qint64 offset, qint64 length);
+
+    static const int TICK_INTERVAL = 20; // ms
+
+    // The mapping must outlive every view handed out, so it is only
+    // released by close(), never by stop()
+    std::shared_ptr<const FallbackFile> m_file;
+    int m_frameIndex = 0;
+    qint64 m_loopBase = 0; // microseconds of completed loops
+    qint64 m_position = 0;
+
+    QTimer* m_timer = nullptr;
+    QElapsedTimer m_clock;
+    qint64 m_byteRate = 16000;
+    qint64 m_bytesSent = 0;
+
+    Q_DISABLE_COPY(FallbackSource)
+};
+
+} // namespace LegacyStream
+
+#endif // FALLBACKSOURCE_H
@@ -0,0 +1,100 @@
+#ifndef HLSARCHIVE_H
+#define HLSARCHIVE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+#include "streaming/HLSSegmenter.h"
+
+namespace LegacyStream {
+
+/**
+ * @brief Index record of one archived segment
+ */
+struct HLSArchiveEntry
+{
+    qint64 sequence = 0;
+    qint64 offset = 0; // in the archive file
+    qint64 length = 0;
+    qint64 startSample = 0;
+    qint64 samples = 0;
+    int sampleRate = 0;
+    int initId = -1;
+    bool discontinuity = false;
+    QDateTime programDateTime;
+
+    double duration() const { return sampleRate > 0 ? static_cast<double>(samples) / sampleRate : 0.0; }
+};
+
+/**
+ * @brief Disk tier of a rendition's DVR window
+ *
+ * Segments are appended to a pre-allocated file mapped into memory and
+ * used as a byte ring; the index is a ring of HLSArchiveEntry in sequence
+ * order, so lookups are by subtraction and expiry only advances the head.
+ * The page cache holds whatever is hot, so the resident cost stays flat
+ * however long the window is. The file is scratch space and is removed
+ * on close.
+ *
+ * Not thread safe; HLSGenerator serialises access.
+ */
+class HLSArchive
+{
+public:
+    HLSArchive() = default;
+    ~HLSArchive();
+
+    bool open(const QString& fileName, qint64 capacity, QString* error = nullptr);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+    qint64 capacity() const { return m_capacity; }
+
+    void setWindow(int seconds);
+    int window() const { return m_window; }
+
+    // Appends a finished segment, evicting the oldest ones it overwrites
+    bool append(const HLSSegment& segment);
+    void addInitSegment(int id, const QByteArray& data) { m_inits.insert(id, data); }
+    QByteArray initSegment(int id) const { return m_inits.value(id); }
+
+    // Drops segments that have fallen out of the window
+    void expire();
+
+    int size() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+    const HLSArchiveEntry& at(int i) const { return m_index.at((m_head + i) % m_index.size()); }
+    const HLSArchiveEntry* entry(qint64 sequence) const;
+    qint64 firstSequence() const { return m_count > 0 ? at(0).sequence : -1; }
+    qint64 lastSequence() const { return m_count > 0 ? at(m_count - 1).sequence : -1; }
+    double duration() const { return m_seconds; }
+
+    // Copied out of the mapped pages: the region may be reused by a later
+    // append once the caller lets go of the lock
+    QByteArray read(qint64 sequence) const;
+
+private:
+    void evictOldest();
+    void clear();
+
+    QFile m_file;
+    uchar* m_data = nullptr;
+    qint64 m_capacity = 0;
+    qint64 m_writePos = 0;
+    int m_window = 0; // seconds
+
+    QVector<HLSArchiveEntry> m_index; // ring, oldest at m_head
+    int m_head = 0;
+    int m_count = 0;
+    double m_seconds = 0.0;
+    QMap<int, QByteArray> m_inits;
+
+    Q_DISABLE_COPY(HLSArchive)
+};
+
+} // namespace LegacyStream
+
+#endif // HLSARCHIVE_H
@@ -12,16 +12,52 @@
 #include <QBuffer>
 #include <QMutex>
 #include <QAtomicInt>
+#include <QHash>
 
-class StreamManager;
+#include <memory>
+
+#include "core/UpgradeHandoff.h"
+#include "streaming/HLSArchive.h"
+#include "streaming/HLSSegmenter.h"
+#include "streaming/HLSWriter.h"
 
 namespace LegacyStream {
 
+class StreamManager;
+
+/**
+ * @brief A playlist rendered once and shared by every request for it
+ *
+ * response holds the complete HTTP/1.1 response, headers included, so a
+ * request is answered by writing one existing buffer.
+ */
+struct RenderedPlaylist
+{
+    QByteArray body;
+    QByteArray etag;
+    QByteArray response;
+    int headerLength = 0;
+    QByteArray notModified; // 304 for a matching If-None-Match
+
+    // Media playlists only: what a blocking reload can wait for
+    qint64 lastSequence = -1; // last complete segment
+    int pendingParts = 0;     // parts published of segment lastSequence + 1
+    int targetDuration = 0;
+
+    bool contains(qint64 msn, int part) const
+    {
+        return msn <= lastSequence || (part >= 0 && msn == lastSequence + 1 && part < pendingParts);
+    }
+};
+
 /**
  * @brief HTTP Live Streaming (HLS) generator for LegacyStream
  * 
  * Generates HLS playlists and segments for adaptive bitrate streaming.
- * Supports multiple quality levels and automatic segment management.
+ * Segments are cut in memory by one HLSSegmenter per rendition and served
+ * straight from its ring by HttpServer. With persistence on, segments and
+ * playlists are also mirrored under the output directory, in the same
+ * layout as the URLs, by an HLSWriter off the event loop.
  */
 class HLSGenerator : public QObject
 {
@@ -44,6 +80,14 @@ public:
     void setPlaylistLength(int segments);
     void setQualityLevels(const QStringList& levels);
     void setTargetBitrates(const QList<int>& bitrates);
+    void setPartDuration(int milliseconds); // LL-HLS partial segments, 0 disables
+    void setContainer(HLSSegmenter::Container container);
+    // Rewind window kept in a disk archive behind the memory ring; 0 turns
+    // it off. Mounts not set here use their configured dvrWindow.
+    void setDvrWindow(const QString& mountPoint, int seconds);
+    // Mirrors segments, init segments and playlists into the output
+    // directory for an external origin; LL-HLS parts stay memory only
+    void setPersistSegments(bool enabled);
 
     // Status and information
     bool isRunning() const;
@@ -53,31 +97,71 @@ public:
 
     // Manual control
     void generateSegment(const QString& mountPoint, const QByteArray& audioData);
+    // Feeds one ladder step, already encoded, of a mount. Steps are aligned
+    // to the mount's timeline and listed in setQualityLevels() order.
+    void generateRendition(const QString& mountPoint, const QString& quality, const QByteArray& encodedData);
     void updatePlaylist(const QString& mountPoint);
     void cleanupOldSegments();
+    void removeMountPoint(const QString& mountPoint);
+
+    // Binary upgrade: where each live mount's timeline stands, and picking
+    // one up in the new process so media sequence numbers carry on past a
+    // discontinuity instead of starting over at zero
+    QVector<UpgradeHandoff::Cursor> timelineCursors() const;
+    void resumeTimeline(const UpgradeHandoff::Cursor& cursor);
+
+    // In-memory delivery. Paths look like /hls/<mount>/master.m3u8,
+    // /hls/<mount>/<quality>/index.m3u8, /hls/<mount>/<quality>/<seq>.<ext>
+    // and, for LL-HLS parts, /hls/<mount>/<quality>/<seq>.<part>.<ext>.
+    // CMAF renditions add /hls/<mount>/<quality>/init-<id>.mp4 and a DASH
+    // manifest at /dash/<mount>/manifest.mpd that points at the same files.
+    bool handleRequest(const QString& path, QByteArray& body, QString& contentType) const;
+    std::shared_ptr<const RenderedPlaylist> getPlaylist(const QString& path) const;
+    QByteArray getMasterPlaylist(const QString& mountPoint) const;
+    QByteArray getMediaPlaylist(const QString& mountPoint, const QString& quality) const;
+    bool getSegment(const QString& mountPoint, const QString& quality, qint64 sequence,
+                    QByteArray& data, QString& contentType) const;
+    bool getPart(const QString& mountPoint, const QString& quality, qint64 sequence, int index,
+                 QByteArray& data, QString& contentType) const;
+    bool getInitSegment(const QString& mountPoint, const QString& quality, int id,
+                        QByteArray& data, QString& contentType) const;
+
+    static const QString SOURCE_QUALITY; // rendition carrying the mount's own feed
 
 signals:
     void segmentGenerated(const QString& mountPoint, const QString& segmentPath);
     void playlistUpdated(const QString& mountPoint, const QString& playlistPath);
+    void mediaPlaylistPublished(const QString& playlistPath);
     void error(const QString& error);
     void statusChanged(const QJsonObject& status);
 
 private slots:
-    void onSegmentTimer();
     void onCleanupTimer();
     void onStreamDataReceived(const QString& mountPoint, const QByteArray& data);
 
 private:
     // Core functionality
-    void generateMasterPlaylist();
-    void generateVariantPlaylist(const QString& quality);
-    void generateSegmentFile(const QString& mountPoint, const QString& quality, const QByteArray& data);
-    void updatePlaylistFile(const QString& mountPoint, const QString& quality);
-    void cleanupExpiredSegments();
+    using PlaylistMap = QHash<QString, std::shared_ptr<const RenderedPlaylist>>; // request path -> playlist
+
+    void pushRendition(const QString& mountPoint, const QString& quality, const QByteArray& data);
+    void alignRendition(const QString& mountPoint, HLSSegmenter& segmenter) const;
+    void archiveSegments(const QString& mountPoint, const QString& key, const HLSSegmenter& segmenter, int completed);
+    void persistSegments(const QString& mountPoint, const QString& quality, const HLSSegmenter& segmenter, int completed);
+    void unpersistRendition(const QString& key);
+    void publishPlaylists(const QString& mountPoint);
+    QByteArray renderMasterPlaylist(const QString& mountPoint) const;
+    QByteArray renderMediaPlaylist(const HLSSegmenter& segmenter, const HLSArchive* archive = nullptr) const;
+    QByteArray renderDashManifest(const QString& mountPoint) const;
+    static std::shared_ptr<const RenderedPlaylist> makePlaylist(const QByteArray& body, int maxAge,
+                                                                const std::shared_ptr<const RenderedPlaylist>& previous,
+                                                                const HLSSegmenter* segmenter = nullptr,
+                                                                const QByteArray& contentType = "application/vnd.apple.mpegurl");
 
     // Utility functions
-    QString generateSegmentFilename(const QString& mountPoint, const QString& quality, int sequence) const;
-    QString generatePlaylistFilename(const QString& mountPoint, const QString& quality) const;
+    QString renditionKey(const QString& mountPoint, const QString& quality) const;
+    QString masterPath(const QString& mountPoint) const;
+    QString mediaPath(const QString& mountPoint, const QString& quality) const;
+    QString dashPath(const QString& mountPoint) const;
     QString formatDuration(int seconds) const;
     QString formatBitrate(int bitrate) const;
     bool ensureDirectoryExists(const QString& path) const;
@@ -87,23 +171,30 @@ private:
     QString m_outputDirectory = "hls";
     int m_segmentDuration = 10;  // seconds
     int m_playlistLength = 10;   // segments
+    int m_partDuration = 0;      // ms, LL-HLS when non-zero
+    HLSSegmenter::Container m_container = HLSSegmenter::Container::PackedAudio;
+    static const int EXTRA_SEGMENTS = 3; // kept past the playlist for slow clients
     QStringList m_qualityLevels = {"high", "medium", "low"};
     QList<int> m_targetBitrates = {256, 128, 64};  // kbps
 
     // State management
     QAtomicInt m_isRunning = 0;
-    QTimer* m_segmentTimer = nullptr;
     QTimer* m_cleanupTimer = nullptr;
-    QMutex m_mutex;
+    bool m_persist = false;
+    HLSWriter* m_writer = nullptr;
+    mutable QMutex m_mutex;
 
     // Segment tracking
-    QMap<QString, int> m_segmentCounters;  // mountPoint -> sequence number
-    QMap<QString, QStringList> m_segmentFiles;  // mountPoint -> list of segment files
-    QMap<QString, QDateTime> m_lastSegmentTime;  // mountPoint -> last segment time
-
-    // Buffer management
-    QMap<QString, QByteArray> m_audioBuffers;  // mountPoint -> accumulated audio data
-    QMap<QString, int> m_bufferSizes;  // mountPoint -> buffer size in bytes
+    QMap<QString, std::shared_ptr<HLSSegmenter>> m_segmenters;  // "mountPoint|quality" -> segmenter
+    QMap<QString, std::shared_ptr<HLSArchive>> m_archives;      // "mountPoint|quality" -> DVR tier
+    QMap<QString, int> m_dvrWindows;                            // mountPoint -> seconds
+    QHash<QString, UpgradeHandoff::Cursor> m_resumeTimelines;   // mountPoint -> inherited timeline
+    QMap<QString, QList<QPair<qint64, QString>>> m_persisted;  // "mountPoint|quality" -> files on disk
+    QMap<QString, QStringList> m_renditions;  // mountPoint -> qualities
+    QMap<QString, QDateTime> m_lastSegmentTime;  // "mountPoint|quality" -> last data time
+
+    // Published with std::atomic_store under m_mutex; readers only atomic_load
+    std::shared_ptr<const PlaylistMap> m_playlists;
 
     // Statistics
     QJsonObject m_statistics;
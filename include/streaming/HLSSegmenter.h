@@ -0,0 +1,181 @@
+#ifndef HLSSEGMENTER_H
+#define HLSSEGMENTER_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+#include "streaming/AudioFrameParser.h"
+#include "streaming/CMAFPackager.h"
+
+namespace LegacyStream {
+
+/**
+ * @brief One LL-HLS partial segment
+ */
+struct HLSPart
+{
+    int index = 0;
+    qint64 samples = 0;
+    int sampleRate = 0;
+    QByteArray data; // parts of a segment concatenate to the segment
+
+    double duration() const { return sampleRate > 0 ? static_cast<double>(samples) / sampleRate : 0.0; }
+};
+
+/**
+ * @brief One finished HLS segment held in memory
+ */
+struct HLSSegment
+{
+    qint64 sequence = 0;
+    qint64 startSample = 0; // samples per channel since the rendition started
+    qint64 samples = 0;
+    int sampleRate = 0;
+    QDateTime programDateTime;
+    bool discontinuity = false; // first segment after a source or format change
+    int initId = -1;            // CMAF init segment, -1 for packed audio
+    QByteArray data;        // ID3 tag and whole frames, or CMAF fragments
+    QVector<HLSPart> parts; // kept for the last few segments only
+
+    double duration() const { return sampleRate > 0 ? static_cast<double>(samples) / sampleRate : 0.0; }
+};
+
+/**
+ * @brief Cuts one rendition into HLS packed-audio segments in memory
+ *
+ * Segments end on the first codec frame boundary at or after a fixed grid
+ * of target-duration lines, counted in samples from the start of the
+ * timeline, so segment lengths never drift with wall-clock jitter in the
+ * ingest path and renditions on the same timeline cut at the same points. Finished segments are kept in a
+ * bounded ring; the oldest is dropped when the ring is full. The codec is
+ * detected from the first frames (MP3 or ADTS AAC).
+ *
+ * With a part duration set, each segment is also published as LL-HLS
+ * partial segments as it grows. Parts never exceed the part target, so
+ * they satisfy PART-TARGET; parts of older segments are released once
+ * they drop out of the low-latency window.
+ *
+ * In the CMAF container each segment is instead one moof+mdat fragment
+ * per part (or one per segment without parts) behind a shared init
+ * segment, which lets HLS and DASH serve the very same bytes. Opus has
+ * no packed-audio form, so Ogg Opus input is always packaged as CMAF.
+ *
+ * Not thread safe; HLSGenerator serialises access.
+ */
+class HLSSegmenter
+{
+public:
+    enum class Container
+    {
+        PackedAudio, // MP3 / ADTS with an ID3 timestamp
+        CMAF         // fragmented MP4
+    };
+
+    explicit HLSSegmenter(int segmentDuration = 6, int capacity = 10);
+
+    void setSegmentDuration(int seconds);
+    void setCapacity(int segments);
+    void setPartDuration(int milliseconds); // 0 disables partial segments
+    int partDuration() const { return m_partDuration; }
+    void setContainer(Container container); // resets on change
+
+    // Joins an existing timeline: the first frame is placed at seconds
+    // and opens segment sequence, flagged as a discontinuity if asked.
+    // Only effective before any data.
+    void alignTo(qint64 sequence, double seconds, bool discontinuity = false);
+    double position() const; // seconds of media pushed since the timeline began
+    bool isFragmented() const { return m_container == Container::CMAF || m_codec == AudioFrameParser::Codec::OGG_OPUS; }
+    void reset();
+
+    // Returns the number of segments completed by this data; when given,
+    // parts receives the number of partial segments completed
+    int push(const QByteArray& data, int* parts = nullptr);
+
+    AudioFrameParser::Codec codec() const { return m_codec; }
+    int sampleRate() const { return m_sampleRate; }
+    int channels() const { return m_channels; }
+    QString fileExtension() const;
+    QString contentType() const;
+    QString codecsAttribute() const;
+    const CMAFTrack& track() const { return m_track; }
+
+    // CMAF only: the init segment of the newest track setup, and any
+    // older one still referenced by a held segment
+    int initId() const { return m_initId; }
+    QByteArray initSegment(int id) const { return m_inits.value(id); }
+
+    const QVector<HLSSegment>& segments() const { return m_segments; }
+    const HLSSegment* segment(qint64 sequence) const;
+    qint64 firstSequence() const { return m_segments.isEmpty() ? m_nextSequence : m_segments.first().sequence; }
+    qint64 lastSequence() const { return m_nextSequence - 1; }
+
+    // Parts of the segment still being built (sequence lastSequence() + 1)
+    const QVector<HLSPart>& pendingParts() const { return m_parts; }
+    const HLSPart* part(qint64 sequence, int index) const;
+    double partTarget() const;
+    int targetDuration() const;
+    qint64 peakBitrate() const;    // bits per second, highest of any segment produced
+    qint64 averageBitrate() const; // over every segment produced
+
+private:
+    bool detectCodec(const QByteArray& data);
+    void addUnit(const char* data, qint64 length, int samples);
+    void appendFrame(const char* data, qint64 length, int samples);
+    void addFragmentedFrame(const uchar* frame, const AudioFrameInfo& info);
+    void setTrack(const CMAFTrack& track);
+    QByteArray finishFragment();
+    void finishPart();
+    void finishSegment();
+    static QByteArray timestampTag(qint64 startSample, int sampleRate);
+
+    static const int PART_HOLD_SEGMENTS = 3; // segments that keep their parts
+
+    int m_segmentDuration;
+    int m_capacity;
+    int m_partDuration = 0; // ms
+    Container m_container = Container::PackedAudio;
+
+    AudioFrameParser::Codec m_codec = AudioFrameParser::Codec::UNKNOWN;
+    AudioFrameAligner m_aligner;
+    int m_sampleRate = 0;
+    int m_channels = 0;
+
+    // Segment being built
+    QByteArray m_current;
+    qint64 m_currentSamples = 0;
+    qint64 m_totalSamples = 0;
+    qint64 m_segmentEnd = 0;       // grid line closing the current segment
+    QDateTime m_currentStart;
+    QVector<HLSPart> m_parts;
+    int m_partStart = 0;          // offset in m_current of the open part
+    qint64 m_partSamples = 0;
+    int m_completedParts = 0;
+
+    // CMAF fragment being built
+    CMAFTrack m_track;
+    int m_initId = -1;
+    QMap<int, QByteArray> m_inits;
+    QVector<CMAFSample> m_fragmentSamples;
+    QByteArray m_fragmentPayload;
+    qint64 m_fragmentDuration = 0;
+    quint32 m_fragmentSequence = 1;
+    QByteArray m_oggPacket; // Opus packet continued across pages
+
+    QVector<HLSSegment> m_segments; // oldest first
+    qint64 m_nextSequence = 0;
+    bool m_discontinuity = false;
+    double m_alignSeconds = -1.0; // pending alignTo()
+
+    // Measured over every segment, so BANDWIDTH holds after a peak scrolls out
+    qint64 m_peakBitrate = 0;
+    qint64 m_producedBytes = 0;
+    double m_producedSeconds = 0.0;
+};
+
+} // namespace LegacyStream
+
+#endif // HLSSEGMENTER_H
@@ -0,0 +1,121 @@
+#ifndef HLSWRITER_H
+#define HLSWRITER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <atomic>
+
+namespace LegacyStream {
+
+/**
+ * @brief Writes HLS segments and playlists to disk off the event loop
+ *
+ * write() only queues the bytes (implicitly shared, so no copy) and
+ * returns; worker threads write each file as <name>.tmp and rename it
+ * into place, so a reader never sees a partial file. Everything a worker
+ * finds queued is handled as one batch: written first, then fsynced
+ * together, then renamed, with one fsync per directory touched.
+ *
+ * Jobs are sharded to workers by path, so writes to one file land in
+ * order, and a playlist rewritten while still queued replaces the queued
+ * copy instead of being written twice. With liburing available on Linux
+ * a single worker submits each batch through io_uring; otherwise a small
+ * pool of threads does blocking writes. When the queue is full new jobs
+ * are dropped and counted rather than blocking the caller.
+ */
+class HLSWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Backend
+    {
+        ThreadPool,
+        IoUring
+    };
+
+    explicit HLSWriter(QObject* parent = nullptr);
+    ~HLSWriter();
+
+    // Paths passed to write() and remove() are relative to directory
+    bool start(const QString& directory, int threads = 2);
+    void stop(); // writes out what is queued, then joins the workers
+    bool isRunning() const { return !m_workers.isEmpty(); }
+    QString directory() const { return m_directory; }
+    Backend backend() const { return m_backend; }
+
+    void setSyncEnabled(bool enabled) { m_sync = enabled; }
+    void setMaxQueueDepth(int jobs) { m_maxQueueDepth = qMax(1, jobs); }
+
+    bool write(const QString& path, const QByteArray& data);
+    bool remove(const QString& path);
+
+    // Metrics; latency is from write() until the file is renamed into place
+    int queueDepth() const { return m_queueDepth.load(std::memory_order_relaxed); }
+    double averageLatency() const; // ms
+    double maxLatency() const;     // ms
+    qint64 writtenFiles() const { return m_written.load(std::memory_order_relaxed); }
+    qint64 failedWrites() const { return m_failed.load(std::memory_order_relaxed); }
+    qint64 droppedWrites() const { return m_dropped.load(std::memory_order_relaxed); }
+    QJsonObject statistics() const;
+
+signals:
+    void writeFailed(const QString& path, const QString& error); // emitted from a worker thread
+
+private:
+    struct Job
+    {
+        QString path; // absolute
+        QByteArray data;
+        bool remove = false;
+        qint64 queuedAt = 0; // ns on m_clock
+    };
+
+    struct Worker
+    {
+        QThread* thread = nullptr;
+        QList<Job> queue;
+        QWaitCondition wake;
+    };
+
+    bool enqueue(Job job);
+    void run(Worker* worker);
+    void writeBatch(QVector<Job>& jobs);
+    void finishJob(const Job& job, const QString& error);
+
+    QString m_directory;
+    Backend m_backend = Backend::ThreadPool;
+    bool m_sync = true;
+    int m_maxQueueDepth = 1024;
+    bool m_stopping = false;
+
+    mutable QMutex m_mutex; // guards the worker queues and m_stopping
+    QVector<Worker*> m_workers;
+    void* m_ring = nullptr; // io_uring of the single uring worker
+
+    QElapsedTimer m_clock;
+    std::atomic<int> m_queueDepth{0};
+    std::atomic<qint64> m_written{0};
+    std::atomic<qint64> m_failed{0};
+    std::atomic<qint64> m_dropped{0};
+    std::atomic<bool> m_stalled{false}; // dropping since the queue last drained
+    std::atomic<qint64> m_latencyTotal{0}; // ns
+    std::atomic<qint64> m_latencyMax{0};   // ns
+
+    static const int BATCH_SIZE = 32;
+
+    Q_DISABLE_COPY(HLSWriter)
+};
+
+} // namespace LegacyStream
+
+#endif // HLSWRITER_H
@@ -7,12 +7,20 @@
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QHostAddress>
+#include <QHash>
+#include <QPointer>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
 #include <memory>
 
+#include "core/UpgradeHandoff.h"
+
 namespace LegacyStream {
 
 class StreamManager;
 class SSLManager;
+class HLSGenerator;
 
 namespace WebInterface {
     class WebInterface;
@@ -35,6 +43,7 @@ public:
     void setHost(const QString& host);
     void setWebInterface(WebInterface::WebInterface* webInterface);
     void setStreamManager(StreamManager* streamManager);
+    void setHLSGenerator(HLSGenerator* hlsGenerator);
     void setSSLManager(SSLManager* sslManager);
     void setMaxConnections(int maxConnections);
 
@@ -48,6 +57,16 @@ public:
     // Statistics
     QMap<QString, QVariant> getStats() const;
 
+    // Binary upgrade. The old process collects its listening socket and,
+    // optionally, every idle connection; once they are taken over it lets
+    // go of them and drains the rest. The new process adopts them before
+    // start(), which then keeps the inherited listening socket.
+    UpgradeHandoff::State handoffState(bool includeConnections) const;
+    void releaseHandoff(const UpgradeHandoff::State& state);
+    bool isDraining() const { return m_draining; }
+    bool adoptListener(qintptr descriptor);
+    bool adoptConnection(const UpgradeHandoff::Connection& connection);
+
 signals:
     void clientConnected(const QString& clientIP);
     void clientDisconnected(const QString& clientIP);
@@ -55,17 +74,23 @@ signals:
     void errorOccurred(const QString& error);
     void connectionAccepted(const QString& clientIP);
     void connectionClosed(const QString& clientIP);
+    void drained(); // the last connection left after releaseHandoff()
 
 private slots:
     void onNewConnection();
     void onClientDisconnected();
     void onClientReadyRead();
+    void onPlaylistPublished(const QString& playlistPath);
+    void onParkTimer();
 
 private:
     // HTTP request handling
+    void processRequests(QTcpSocket* socket, QByteArray buffer);
     void handleHttpRequest(QTcpSocket* socket, const QString& request);
+    void finishRequest(QTcpSocket* socket, const QMap<QString, QString>& headers);
     void sendHttpResponse(QTcpSocket* socket, int statusCode, const QString& statusText,
-                         const QString& contentType, const QByteArray& body);
+                         const QString& contentType, const QByteArray& body,
+                         const QMap<QString, QString>& extraHeaders = QMap<QString, QString>());
     void sendErrorResponse(QTcpSocket* socket, int statusCode, const QString& message);
     
     // Request parsing
@@ -78,11 +103,21 @@ private:
     void handleRoute(QTcpSocket* socket, const QString& method, const QString& path,
                     const QMap<QString, QString>& headers, const QString& body);
     void handleStaticFile(QTcpSocket* socket, const QString& path);
+    void handleHlsRequest(QTcpSocket* socket, const QString& method, const QString& path,
+                          const QString& query, const QMap<QString, QString>& headers);
+    void parkRequest(const QString& playlistPath, int targetDuration, QTcpSocket* socket, const QString& method,
+                     const QString& path, const QString& query, const QMap<QString, QString>& headers);
     void handleApiRequest(QTcpSocket* socket, const QString& method, const QString& path,
                          const QMap<QString, QString>& headers, const QString& body);
     void handleWebInterfaceRequest(QTcpSocket* socket, const QString& method, const QString& path,
                                  const QMap<QString, QString>& headers, const QString& body);
 
+    // Listener sessions, one per connection, on the mount first requested
+    bool beginSession(QTcpSocket* socket, const QString& route, const QMap<QString, QString>& headers);
+    void endSession(QTcpSocket* socket);
+    void trackSession(QTcpSocket* socket, quint64 id);
+    void addClient(QTcpSocket* socket);
+
     // Utility methods
     QString getMimeType(const QString& filename) const;
     QString urlDecode(const QString& encoded) const;
@@ -92,15 +127,34 @@ private:
     // Server components
     QTcpServer* m_tcpServer = nullptr;
     QList<QTcpSocket*> m_clients;
+    QMap<QTcpSocket*, QByteArray> m_requestBuffers;  // partial request headers
+    QHash<QTcpSocket*, quint64> m_sessions;          // ListenerRegistry ids
+    static const int MAX_REQUEST_SIZE = 16384;
+
+    // LL-HLS blocking playlist reloads waiting for a segment or part
+    struct ParkedRequest
+    {
+        QPointer<QTcpSocket> socket;
+        QString method;
+        QString path;
+        QString query;
+        QMap<QString, QString> headers;
+        qint64 deadline = 0; // ms since epoch
+    };
+    QHash<QString, QVector<ParkedRequest>> m_parkedRequests; // by media playlist path
+    QSet<QTcpSocket*> m_parkedSockets; // later pipelined requests wait their turn
+    QTimer* m_parkTimer = nullptr;
     
     // Configuration
     int m_port = 8080;
     QString m_host = "0.0.0.0";
     bool m_isRunning = false;
+    bool m_draining = false; // handed over; every connection closes after its response
     
     // Component references
     WebInterface::WebInterface* m_webInterface = nullptr;
     StreamManager* m_streamManager = nullptr;
+    HLSGenerator* m_hlsGenerator = nullptr;
     
     // Static file handling
     QString m_staticFilesPath = "static";
@@ -0,0 +1,126 @@
+#ifndef LISTENERREGISTRY_H
+#define LISTENERREGISTRY_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace LegacyStream {
+
+/**
+ * @brief Snapshot of one connected listener
+ */
+struct ListenerSession
+{
+    quint64 id = 0;
+    QString mountPoint;
+    QString address;
+    quint32 userAgentHash = 0;
+    qint64 connectTime = 0; // ms since epoch
+    qint64 bytesSent = 0;
+};
+
+/**
+ * @brief Live counters of one mount, readable without any lock
+ */
+struct ListenerCounters
+{
+    std::atomic<int> listeners{0};
+    std::atomic<qint64> bytesSent{0};
+};
+
+/**
+ * @brief Every connected listener, by mount
+ *
+ * Sessions live in a slab of fixed-size chunks that are never freed or
+ * moved, with released slots on a free list, and each mount threads its
+ * sessions on an intrusive doubly linked list; connect and disconnect are
+ * O(1) under the lock and allocate nothing once the slab is warm.
+ *
+ * Session ids carry the slot's generation, so a stale id is ignored. The
+ * hot paths skip the lock entirely: addBytesSent() and the totals only
+ * touch atomics, and the server-wide totals are split over cache-line
+ * sized shards so concurrent writers do not bounce one line.
+ */
+class ListenerRegistry
+{
+public:
+    ListenerRegistry();
+    ~ListenerRegistry();
+
+    quint64 connect(const QString& mountPoint, const QString& address, const QByteArray& userAgent);
+    // Re-opens a session taken over from another process; its connect
+    // time and bytes carry over, the mount and server totals do not
+    quint64 restore(const ListenerSession& session);
+    bool disconnect(quint64 id);
+    void addBytesSent(quint64 id, qint64 bytes);
+
+    // Lock-free
+    int totalListeners() const;
+    qint64 totalBytesSent() const;
+
+    // Stable for the registry's lifetime; the entry for a mount is created
+    // on first use and reads zero until someone connects
+    const ListenerCounters* counters(const QString& mountPoint);
+    int listenerCount(const QString& mountPoint) const;
+    qint64 bytesSent(const QString& mountPoint) const;
+    QVector<ListenerSession> sessions(const QString& mountPoint) const;
+    ListenerSession session(quint64 id) const; // id 0 when it is gone
+
+private:
+    struct Mount
+    {
+        QString mountPoint;
+        int head = -1; // newest session
+        ListenerCounters counters;
+    };
+
+    struct Slot
+    {
+        std::atomic<quint32> generation{1}; // odd while free, even while in use
+        std::atomic<Mount*> mount{nullptr};
+        int prev = -1;
+        int next = -1; // mount list while in use, free list while free
+        QString address;
+        quint32 userAgentHash = 0;
+        qint64 connectTime = 0;
+        std::atomic<qint64> bytesSent{0};
+    };
+
+    struct alignas(64) Shard
+    {
+        std::atomic<int> listeners{0};
+        std::atomic<qint64> bytesSent{0};
+    };
+
+    static const int CHUNK_BITS = 10;
+    static const int CHUNK_SIZE = 1 << CHUNK_BITS;
+    static const int MAX_CHUNKS = 4096; // four million sessions
+    static const int SHARDS = 16;
+
+    Slot* slot(int index) const;
+    quint64 open(const QString& mountPoint, const QString& address, quint32 userAgentHash,
+                 qint64 connectTime, qint64 bytesSent);
+    Mount* mountFor(const QString& mountPoint); // m_mutex held
+    bool grow();                                // m_mutex held
+
+    mutable QMutex m_mutex;
+    std::atomic<Slot*> m_chunks[MAX_CHUNKS];
+    int m_chunkCount = 0;
+    int m_freeHead = -1;
+    QHash<QString, Mount*> m_mountIndex;
+    std::vector<std::unique_ptr<Mount>> m_mounts;
+    Shard m_shards[SHARDS];
+
+    Q_DISABLE_COPY(ListenerRegistry)
+};
+
+} // namespace LegacyStream
+
+#endif // LISTENERREGISTRY_H
@@ -12,6 +12,8 @@
 #include <memory>
 #include <functional>
 
+#include "streaming/LoudnessMeter.h"
+
 namespace LegacyStream {
 
 /**
@@ -49,6 +51,11 @@ struct AudioQualityMetrics
     double bass = 0.0;
     double mid = 0.0;
     double treble = 0.0;
+    double momentaryLoudness = -70.0; // LUFS
+    double shortTermLoudness = -70.0; // LUFS
+    double integratedLoudness = -70.0; // LUFS
+    double loudnessRange = 0.0; // LU
+    double truePeak = -70.0; // dBTP
     QDateTime timestamp;
     QString streamId;
 };
@@ -70,6 +77,10 @@ struct AudioMonitorConfig
     bool enableAlerts = true;
     double qualityThreshold = 0.7;
     double volumeThreshold = -20.0;
+    bool enableLoudnessMetering = true;
+    double targetLoudness = -23.0; // LUFS (EBU R128)
+    double loudnessTolerance = 1.0; // LU
+    double truePeakLimit = -1.0; // dBTP
     int analysisInterval = 100; // 100ms
     bool enableLogging = true;
 };
@@ -79,7 +90,7 @@ struct AudioMonitorConfig
  */
 struct AudioAlert
 {
-    QString type; // "quality", "volume", "distortion", "noise"
+    QString type; // "quality", "volume", "distortion", "noise", "loudness", "true_peak"
     QString severity; // "warning", "critical"
     QString message;
     double currentValue;
@@ -98,6 +109,7 @@ struct AudioMonitorStats
     int qualityAlerts = 0;
     int volumeAlerts = 0;
     int distortionAlerts = 0;
+    int loudnessAlerts = 0;
     double averageQuality = 0.0;
     double averageVolume = 0.0;
     double peakVolume = 0.0;
@@ -153,6 +165,14 @@ public:
     double getClarity(const QString& streamId) const;
     double getLoudness(const QString& streamId) const;
 
+    // Loudness metering (EBU R128)
+    void enableLoudnessMetering(const QString& name, bool enabled);
+    void setLoudnessTarget(const QString& name, double targetLoudness, double tolerance, double truePeakLimit);
+    LoudnessMeasurement getLoudnessMeasurement(const QString& streamId) const;
+    double getIntegratedLoudness(const QString& streamId) const;
+    double getTruePeak(const QString& streamId) const;
+    void resetLoudness(const QString& streamId);
+
     // Spectrum analysis
     void enableSpectrumAnalysis(const QString& name, bool enabled);
     void setFFTSize(const QString& name, int size);
@@ -189,6 +209,7 @@ signals:
     void audioAlert(const AudioAlert& alert);
     void qualityWarning(const QString& streamId, double quality, double threshold);
     void volumeWarning(const QString& streamId, double volume, double threshold);
+    void loudnessWarning(const QString& streamId, double loudness, double target);
     void statisticsUpdated(const QString& name, const AudioMonitorStats& stats);
 
 public slots:
@@ -210,6 +231,7 @@ private:
         QMap<QString, AudioAnalysisData> latestAnalyses;
         QMap<QString, AudioQualityMetrics> latestQualityMetrics;
         QMap<QString, QList<double>> audioBuffers;
+        QMap<QString, std::shared_ptr<LoudnessMeter>> loudnessMeters;
         QList<AudioAlert> alerts;
         QMutex mutex;
         QTimer* analysisTimer = nullptr;
@@ -222,6 +244,8 @@ private:
     void performAudioAnalysis(AudioMonitor& monitor, const QString& streamId);
     void calculateQualityMetrics(AudioMonitor& monitor, const QString& streamId);
     void checkAudioAlerts(AudioMonitor& monitor, const QString& streamId);
+    void updateLoudness(AudioMonitor& monitor, const QByteArray& buffer, const QString& streamId);
+    void checkLoudnessAlerts(AudioMonitor& monitor, const QString& streamId);
     void generateAudioAlert(AudioMonitor& monitor, const QString& type, double value, double threshold, const QString& streamId);
 
     // Audio analysis
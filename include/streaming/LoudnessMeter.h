@@ -0,0 +1,131 @@
+#ifndef LOUDNESSMETER_H
+#define LOUDNESSMETER_H
+
+#include <QtGlobal>
+#include <QJsonObject>
+#include <array>
+#include <vector>
+
+namespace LegacyStream {
+
+/**
+ * @brief Loudness measurement snapshot (EBU R128 / ITU-R BS.1770-4)
+ */
+struct LoudnessMeasurement
+{
+    double momentaryLoudness = -70.0;  // LUFS, 400ms window
+    double shortTermLoudness = -70.0;  // LUFS, 3s window
+    double integratedLoudness = -70.0; // LUFS, gated, since last reset
+    double loudnessRange = 0.0;        // LU (EBU Tech 3342)
+    double truePeak = -70.0;           // dBTP, 4x oversampled, since last reset
+    double integratedDuration = 0.0;   // seconds of audio measured
+};
+
+/**
+ * @brief Streaming EBU R128 loudness meter
+ *
+ * Applies the BS.1770 K-weighting pre-filter, accumulates 100ms sub-blocks
+ * and derives momentary, short-term and gated integrated loudness, loudness
+ * range and 4x oversampled true peak. Gating uses fixed-size histograms of
+ * block loudness instead of stored blocks, so memory use is constant no
+ * matter how long the integration runs.
+ *
+ * Not thread safe; callers serialize access per stream.
+ */
+class LoudnessMeter
+{
+public:
+    explicit LoudnessMeter(int sampleRate = 48000, int channels = 2);
+
+    void configure(int sampleRate, int channels);
+    void reset();
+    void resetIntegrated();
+
+    // Interleaved PCM input
+    void process(const qint16* samples, qint64 frames);
+    void process(const float* samples, qint64 frames);
+
+    // Results
+    double momentaryLoudness() const;
+    double shortTermLoudness() const;
+    double integratedLoudness() const;
+    double loudnessRange() const;
+    double truePeak() const;
+    LoudnessMeasurement measurement() const;
+    QJsonObject toJson() const;
+
+    int sampleRate() const { return m_sampleRate; }
+    int channels() const { return m_channels; }
+
+    static constexpr double ABSOLUTE_GATE = -70.0;      // LUFS
+    static constexpr double RELATIVE_GATE = -10.0;      // LU, integrated
+    static constexpr double LRA_RELATIVE_GATE = -20.0;  // LU, loudness range
+
+private:
+    struct Biquad
+    {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0;
+        double a1 = 0.0, a2 = 0.0;
+    };
+
+    struct ChannelState
+    {
+        double z1[2] = {0.0, 0.0}; // Transposed direct form II state per stage
+        double z2[2] = {0.0, 0.0};
+        std::array<float, 12> history{}; // True-peak interpolator taps
+        int historyPos = 0;
+        double weight = 1.0;
+    };
+
+    // Histogram of block loudness from ABSOLUTE_GATE to +5 LUFS in 0.1 LU steps
+    static constexpr int HISTOGRAM_BINS = 750;
+    static constexpr double HISTOGRAM_STEP = 0.1;
+    static constexpr int SHORT_TERM_SUBBLOCKS = 30; // 30 x 100ms = 3s
+    static constexpr int MOMENTARY_SUBBLOCKS = 4;   // 4 x 100ms = 400ms
+
+    struct GatingHistogram
+    {
+        std::array<quint32, HISTOGRAM_BINS> counts{};
+        std::array<double, HISTOGRAM_BINS> energy{};
+        quint64 total = 0;
+
+        void add(double blockEnergy, double loudness);
+        void clear();
+        int binForLoudness(double loudness) const;
+    };
+
+    void designFilters();
+    inline void processFrame(const float* frame);
+    void finishSubBlock();
+    double truePeakSample(ChannelState& state, float sample) const;
+    double windowEnergy(int subBlocks) const;
+
+    static double energyToLoudness(double energy);
+
+    int m_sampleRate = 48000;
+    int m_channels = 2;
+    int m_subBlockFrames = 4800;
+
+    Biquad m_shelf;
+    Biquad m_highPass;
+    std::vector<ChannelState> m_channelState;
+    std::vector<float> m_frameScratch;
+
+    // Sub-block accumulation
+    double m_subBlockSum = 0.0;
+    int m_subBlockPos = 0;
+    std::array<double, SHORT_TERM_SUBBLOCKS> m_subBlocks{};
+    int m_subBlockIndex = 0;
+    quint64 m_subBlockCount = 0;
+
+    // Gating
+    GatingHistogram m_integratedHistogram;
+    GatingHistogram m_rangeHistogram;
+    quint64 m_integratedSubBlocks = 0;
+
+    double m_truePeak = 0.0; // linear
+};
+
+} // namespace LegacyStream
+
+#endif // LOUDNESSMETER_H
@@ -0,0 +1,109 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QByteArray>
+#include <QtGlobal>
+#include <memory>
+#include <vector>
+
+namespace LegacyStream {
+
+/**
+ * @brief Interleaved integer PCM layout
+ */
+struct PcmFormat
+{
+    int sampleRate = 44100;
+    int channels = 2;
+    int bitDepth = 16; // 8 (unsigned), 16, 24 (packed) or 32
+
+    int bytesPerFrame() const { return channels * (bitDepth / 8); }
+    bool operator==(const PcmFormat& other) const
+    {
+        return sampleRate == other.sampleRate && channels == other.channels && bitDepth == other.bitDepth;
+    }
+    bool operator!=(const PcmFormat& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Polyphase windowed-sinc sample rate converter
+ *
+ * Converts sample rate, channel layout and bit depth in a single pass:
+ * input frames are decoded (and down-mixed) straight into planar float
+ * history, filtered through a rational L/M polyphase bank and encoded
+ * (and up-mixed) straight into the output buffer. Filter banks are shared
+ * between instances, and the common broadcast ratios (44.1k <-> 48k,
+ * 48k -> 32k, 48k -> 22.05k) can be precomputed at startup.
+ *
+ * In streaming use the converter keeps its filter history and phase
+ * across process() calls, so chunk boundaries are seamless. Not thread
+ * safe; use one instance per stream.
+ */
+class Resampler
+{
+public:
+    static constexpr int DEFAULT_TAPS = 64; // Taps per phase at unity ratio
+    static constexpr int MAX_CHANNELS = 8;
+    static constexpr int MAX_PHASES = 2048;
+
+    Resampler();
+    Resampler(const PcmFormat& input, const PcmFormat& output, int taps = DEFAULT_TAPS);
+    ~Resampler();
+
+    bool configure(const PcmFormat& input, const PcmFormat& output, int taps = DEFAULT_TAPS);
+    void reset();
+
+    // Streaming conversion; partial trailing frames are carried to the next call
+    QByteArray process(const QByteArray& input);
+    void process(const char* input, qint64 bytes, QByteArray& output);
+    QByteArray flush();
+
+    // One-shot conversion of a complete buffer
+    static QByteArray convert(const QByteArray& input, const PcmFormat& from, const PcmFormat& to);
+    static void precomputeCommonRatios(int taps = DEFAULT_TAPS);
+
+    const PcmFormat& inputFormat() const { return m_input; }
+    const PcmFormat& outputFormat() const { return m_output; }
+    bool isPassthrough() const { return m_input == m_output; }
+    bool isResampling() const { return m_bank != nullptr; }
+    int latencyFrames() const;
+
+private:
+    struct FilterBank;
+
+    static std::shared_ptr<const FilterBank> filterBank(int upFactor, int downFactor, int taps);
+    static std::shared_ptr<FilterBank> designFilterBank(int upFactor, int downFactor, int taps);
+
+    void buildChannelMatrices();
+    void decodeFrames(const char* input, qint64 frames);
+    void encodeFrame(const float* values, char*& out) const;
+    void convertDirect(const char* input, qint64 frames, QByteArray& output) const;
+    void runFilter(QByteArray& output);
+
+    static float readSample(const char* p, int bitDepth);
+    static void writeSample(char* p, float value, int bitDepth);
+
+    PcmFormat m_input;
+    PcmFormat m_output;
+    int m_processChannels = 2; // Channels carried through the filter
+
+    // Rational ratio L/M and its bank
+    qint64 m_upFactor = 1;
+    qint64 m_downFactor = 1;
+    std::shared_ptr<const FilterBank> m_bank;
+
+    // Mixing applied while decoding (input -> process) or encoding (process -> output)
+    std::vector<float> m_downmix;
+    std::vector<float> m_upmix;
+
+    // Planar history; m_time is the next output position in units of 1/L input frames
+    std::vector<std::vector<float>> m_planes;
+    qint64 m_time = 0;
+
+    // Bytes of an incomplete input frame carried between calls
+    QByteArray m_pending;
+};
+
+} // namespace LegacyStream
+
+#endif // RESAMPLER_H
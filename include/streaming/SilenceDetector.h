@@ -0,0 +1,89 @@
+#ifndef SILENCEDETECTOR_H
+#define SILENCEDETECTOR_H
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include "streaming/AudioFrameParser.h"
+
+namespace LegacyStream {
+
+/**
+ * @brief Dead-air detection settings
+ */
+struct SilenceDetectorConfig
+{
+    double silenceThreshold = -60.0;  // dBFS, PCM mean-square level
+    double silenceDuration = 10.0;    // seconds of continuous silence before dead air
+    double recoveryDuration = 1.0;    // seconds of audio before dead air clears
+    double reservoirThreshold = 0.02; // fraction of frame bits used by MP3 main data
+    int aacSilentFrameBytes = 16;     // ADTS payload bytes per channel
+    int pcmStride = 8;                // examine every Nth PCM sample
+};
+
+/**
+ * @brief Low-cost dead-air detector for the ingest path
+ *
+ * Judges silence without decoding: PCM from sampled mean-square energy,
+ * MP3 from the main-data bit count in each frame's side info (silent
+ * frames leave almost the whole frame to the bit reservoir), and AAC from
+ * the ADTS frame size. Elapsed time is counted in audio samples, so the
+ * result does not depend on how data is chunked on the wire.
+ *
+ * Codecs it cannot inspect cheaply (Ogg, FLAC) are only covered by the
+ * stall detection in StreamManager. Not thread safe; one per mount.
+ */
+class SilenceDetector
+{
+public:
+    enum class Format
+    {
+        PCM16,
+        MP3,
+        AAC_ADTS,
+        UNSUPPORTED
+    };
+
+    explicit SilenceDetector(const SilenceDetectorConfig& config = SilenceDetectorConfig());
+
+    void setFormat(Format format, int sampleRate = 44100, int channels = 2);
+    void setConfig(const SilenceDetectorConfig& config);
+    const SilenceDetectorConfig& config() const { return m_config; }
+    void reset();
+
+    // Returns true when the dead-air state changed
+    bool feed(const QByteArray& data);
+
+    bool isDeadAir() const { return m_deadAir; }
+    bool isSupported() const { return m_format != Format::UNSUPPORTED; }
+    double silentSeconds() const { return m_silentSeconds; }
+    double lastLevel() const { return m_lastLevel; }
+
+    static Format formatForCodec(const QString& codec);
+
+private:
+    void feedPcm(const char* data, qint64 size);
+    void feedFrames(const char* data, qint64 size);
+    bool isSilentFrame(const AudioFrameInfo& frame);
+    void account(bool silent, double seconds);
+
+    SilenceDetectorConfig m_config;
+    Format m_format = Format::UNSUPPORTED;
+    int m_sampleRate = 44100;
+    int m_channels = 2;
+
+    // Frame header bytes split across chunks, and frame bytes still to skip
+    QByteArray m_carry;
+    qint64 m_skipBytes = 0;
+    bool m_pcmOddByte = false;
+
+    double m_silentSeconds = 0.0;
+    double m_audibleSeconds = 0.0;
+    double m_lastLevel = 0.0; // dBFS for PCM, MP3 used-bit ratio, AAC bytes per channel
+    bool m_deadAir = false;
+};
+
+} // namespace LegacyStream
+
+#endif // SILENCEDETECTOR_H
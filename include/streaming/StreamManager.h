@@ -8,10 +8,20 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QByteArray>
+#include <QDateTime>
+#include <QHash>
 #include <QString>
 
+#include <atomic>
+#include <memory>
+
+#include "streaming/ListenerRegistry.h"
+#include "streaming/SilenceDetector.h"
+
 namespace LegacyStream {
 
+class FallbackSource;
+
 /**
  * @brief Audio codec types
  */
@@ -42,6 +52,9 @@ struct StreamInfo
     int listeners = 0;
     QDateTime startTime;
     QString metadata;
+    bool fallbackActive = false;
+    QString fallbackReason;
+    bool draining = false; // removed from the configuration, waiting for listeners to leave
 };
 
 /**
@@ -49,6 +62,12 @@ struct StreamInfo
  * 
  * Manages audio streams, codecs, and provides stream data to other components.
  * Supports multiple codecs and real-time stream processing.
+ *
+ * The mount registry is read-copy-update: writers copy the map under
+ * m_mutex and publish it with std::atomic_store, readers take a snapshot
+ * with std::atomic_load and never touch the lock, so status and API
+ * queries cannot stall ingest. Byte and listener counts are atomics
+ * shared by every version of a mount's record.
  */
 class StreamManager : public QObject
 {
@@ -70,6 +89,13 @@ public:
     void updateStream(const QString& mountPoint, const StreamInfo& info);
     void setStreamActive(const QString& mountPoint, bool active);
 
+    // Live reconfiguration: sources and listeners stay connected. A
+    // draining mount refuses new listeners and is removed once the last
+    // one leaves or the timeout passes; reconfiguring it cancels the drain.
+    void reconfigureStream(const QString& mountPoint, const QString& codec, int bitrate);
+    void drainStream(const QString& mountPoint, int timeoutMs);
+    void refreshFallback(const QString& mountPoint); // picks up a changed fallback file
+
     // Codec management
     bool isCodecSupported(const QString& codec) const;
     QStringList getSupportedCodecs() const;
@@ -78,10 +104,23 @@ public:
 
     // Stream data
     void processStreamData(const QString& mountPoint, const QByteArray& data);
+
+    // Source handover. A source attached with priority at or above the live
+    // one takes over at its first whole frame; lower ones wait as standby.
+    void attachSource(const QString& mountPoint, const QString& sourceId, int priority = 0);
+    void detachSource(const QString& mountPoint, const QString& sourceId);
+    void processSourceData(const QString& mountPoint, const QString& sourceId, const QByteArray& data);
+    QString getActiveSource(const QString& mountPoint) const;
     void setStreamMetadata(const QString& mountPoint, const QString& metadata);
 
-    // Status and information
+    // Dead air and fallback
+    void setSilenceDetectorConfig(const SilenceDetectorConfig& config);
+    void setStallTimeout(int milliseconds);
+    bool isFallbackActive(const QString& mountPoint) const;
+
+    // Status and information; none of these take the ingest lock
     bool isRunning() const;
+    bool hasStream(const QString& mountPoint) const;
     QList<StreamInfo> getStreams() const;
     StreamInfo getStreamInfo(const QString& mountPoint) const;
     QJsonObject getStatusJson() const;
@@ -91,9 +130,12 @@ public:
     // Statistics
     qint64 getTotalBytesReceived() const;
     qint64 getTotalBytesSent() const;
-    int getTotalListeners() const;
+    int getTotalListeners() const; // lock-free
     int getActiveStreams() const;
 
+    // Listener sessions of every mount; connections register here
+    ListenerRegistry& listenerRegistry() { return m_listeners; }
+
 signals:
     void streamAdded(const QString& mountPoint);
     void streamRemoved(const QString& mountPoint);
@@ -103,6 +145,9 @@ signals:
     void statusChanged(const QJsonObject& status);
     void streamConnected(const QString& mountPoint);
     void streamDisconnected(const QString& mountPoint);
+    void fallbackActivated(const QString& mountPoint, const QString& fileName, const QString& reason);
+    void fallbackDeactivated(const QString& mountPoint);
+    void sourceHandover(const QString& mountPoint, const QString& fromSource, const QString& toSource);
 
 private slots:
     void onUpdateTimer();
@@ -118,23 +163,77 @@ private:
     CodecType stringToCodec(const QString& codec) const;
     bool isValidMountPoint(const QString& mountPoint) const;
 
+    // Mount registry
+    struct StreamCounters
+    {
+        std::atomic<qint64> bytesReceived{0};
+        const ListenerCounters* listeners = nullptr;
+    };
+
+    struct StreamRecord
+    {
+        StreamInfo info; // immutable once published
+        std::shared_ptr<StreamCounters> counters;
+    };
+
+    using StreamMap = QHash<QString, std::shared_ptr<const StreamRecord>>;
+
+    std::shared_ptr<const StreamRecord> findStream(const QString& mountPoint) const;
+    StreamInfo currentInfo(const StreamRecord& record) const;
+    void publishStream(const QString& mountPoint, const StreamInfo& info);
+    void unpublishStream(const QString& mountPoint);
+
+    // Source handover and fallback handling
+    struct SourceSlot
+    {
+        int priority = 0;
+        AudioFrameAligner aligner;
+        qint64 attachTime = 0;
+        bool takeover = false; // cut over at the next whole frame
+    };
+
+    struct IngestState
+    {
+        std::shared_ptr<SilenceDetector> detector;
+        std::shared_ptr<StreamCounters> counters;
+        FallbackSource* fallback = nullptr;
+        qint64 lastDataTime = 0; // ms since epoch
+        bool stalled = false;
+        qint64 drainDeadline = 0; // ms since epoch, 0 unless draining
+
+        QMap<QString, SourceSlot> sources;
+        QString activeSource;
+        int activePriority = 0;
+        bool hasActiveSource = false;
+    };
+
+    void addSourceSlot(const QString& mountPoint, IngestState& state, const QString& sourceId, int priority);
+    void cutOver(IngestState& state, const QString& sourceId);
+    bool promoteStandby(IngestState& state);
+
+    QString resolveFallbackFile(const QString& mountPoint) const;
+    void activateFallback(const QString& mountPoint, const QString& reason);
+    void deactivateFallback(const QString& mountPoint);
+
     // Configuration
-    QMap<QString, StreamInfo> m_streams;
+    std::shared_ptr<const StreamMap> m_streams; // atomic_store under m_mutex, atomic_load anywhere
     QMap<QString, bool> m_enabledCodecs;
     QStringList m_supportedCodecs = {"mp3", "aac", "aac+", "ogg", "opus", "flac"};
+    QMap<QString, IngestState> m_ingest;
+    SilenceDetectorConfig m_silenceConfig;
+    int m_stallTimeout = 5000; // ms without source data before falling back
 
     // State management
     QAtomicInt m_isRunning = 0;
     QTimer* m_updateTimer = nullptr;
-    QMutex m_mutex;
+    mutable QMutex m_mutex; // serialises registry writers and guards m_ingest
 
     // Statistics
     QJsonObject m_statistics;
     QDateTime m_startTime;
-    qint64 m_totalBytesReceived = 0;
-    qint64 m_totalBytesSent = 0;
-    int m_totalListeners = 0;
-    int m_activeStreams = 0;
+    std::atomic<qint64> m_totalBytesReceived{0};
+    std::atomic<int> m_activeStreams{0};
+    ListenerRegistry m_listeners;
 
     Q_DISABLE_COPY(StreamManager)
 };
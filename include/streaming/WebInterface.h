@@ -188,8 +188,7 @@ private:
     bool m_isInitialized = false;
 
     // Mount point data
-    QMap<QString, MountPointInfo> m_mountPoints;
-    QMap<QString, QStringList> m_listeners;  // mountPoint -> list of client IPs
+    QMap<QString, MountPointInfo> m_mountPoints;  // listener counts come from StreamManager's ListenerRegistry
 
     // Customization
     QString m_customTheme;
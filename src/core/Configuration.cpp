@@ -47,6 +47,8 @@ void Configuration::save()
     m_settings->setValue("server/bindAddress", m_bindAddress.toString());
     m_settings->setValue("server/maxConnections", m_maxConnections);
     m_settings->setValue("server/maxStreams", m_maxStreams);
+    m_settings->setValue("server/upgradeSocket", m_upgradeSocket);
+    m_settings->setValue("server/upgradeHandoffListeners", m_upgradeHandoffListeners);
     
     // Stream settings
     m_settings->setValue("stream/defaultLatency", m_defaultLatency);
@@ -78,6 +80,8 @@ void Configuration::save()
     m_settings->setValue("protocols/hls", m_hlsEnabled);
     m_settings->setValue("protocols/hlsSegmentDuration", m_hlsSegmentDuration);
     m_settings->setValue("protocols/hlsPlaylistSize", m_hlsPlaylistSize);
+    m_settings->setValue("protocols/hlsContainer", m_hlsContainer);
+    m_settings->setValue("protocols/hlsPersistSegments", m_hlsPersistSegments);
     
     // Codecs
     m_settings->setValue("codecs/enabled", m_enabledCodecs);
@@ -154,6 +158,8 @@ void Configuration::saveToFile(const QString& filePath)
     tempSettings.setValue("server/bindAddress", m_bindAddress.toString());
     tempSettings.setValue("server/maxConnections", m_maxConnections);
     tempSettings.setValue("server/maxStreams", m_maxStreams);
+    tempSettings.setValue("server/upgradeSocket", m_upgradeSocket);
+    tempSettings.setValue("server/upgradeHandoffListeners", m_upgradeHandoffListeners);
     
     // Stream settings
     tempSettings.setValue("stream/defaultLatency", m_defaultLatency);
@@ -185,6 +191,8 @@ void Configuration::saveToFile(const QString& filePath)
     tempSettings.setValue("protocols/hls", m_hlsEnabled);
     tempSettings.setValue("protocols/hlsSegmentDuration", m_hlsSegmentDuration);
     tempSettings.setValue("protocols/hlsPlaylistSize", m_hlsPlaylistSize);
+    tempSettings.setValue("protocols/hlsContainer", m_hlsContainer);
+    tempSettings.setValue("protocols/hlsPersistSegments", m_hlsPersistSegments);
     
     // Codecs
     tempSettings.setValue("codecs/enabled", m_enabledCodecs);
@@ -260,6 +268,8 @@ void Configuration::load()
     m_bindAddress = QHostAddress(m_settings->value("server/bindAddress", m_bindAddress.toString()).toString());
     m_maxConnections = m_settings->value("server/maxConnections", m_maxConnections).toInt();
     m_maxStreams = m_settings->value("server/maxStreams", m_maxStreams).toInt();
+    m_upgradeSocket = m_settings->value("server/upgradeSocket", m_upgradeSocket).toString();
+    m_upgradeHandoffListeners = m_settings->value("server/upgradeHandoffListeners", m_upgradeHandoffListeners).toBool();
     
     // Stream settings
     m_defaultLatency = m_settings->value("stream/defaultLatency", m_defaultLatency).toInt();
@@ -291,6 +301,8 @@ void Configuration::load()
     m_hlsEnabled = m_settings->value("protocols/hls", m_hlsEnabled).toBool();
     m_hlsSegmentDuration = m_settings->value("protocols/hlsSegmentDuration", m_hlsSegmentDuration).toInt();
     m_hlsPlaylistSize = m_settings->value("protocols/hlsPlaylistSize", m_hlsPlaylistSize).toInt();
+    m_hlsContainer = m_settings->value("protocols/hlsContainer", m_hlsContainer).toString();
+    m_hlsPersistSegments = m_settings->value("protocols/hlsPersistSegments", m_hlsPersistSegments).toBool();
     
     // Codecs
     m_enabledCodecs = m_settings->value("codecs/enabled", m_enabledCodecs).toStringList();
@@ -368,6 +380,8 @@ void Configuration::setDefaultValues()
     m_bindAddress = QHostAddress::Any;
     m_maxConnections = 100000;
     m_maxStreams = 1000;
+    m_upgradeSocket.clear();
+    m_upgradeHandoffListeners = true;
     
     // Stream settings
     m_defaultLatency = 5;
@@ -399,6 +413,8 @@ void Configuration::setDefaultValues()
     m_hlsEnabled = true;
     m_hlsSegmentDuration = 6;
     m_hlsPlaylistSize = 6;
+    m_hlsContainer = "packed";
+    m_hlsPersistSegments = false;
     
     // Codecs
     m_enabledCodecs = {"mp3", "aac", "aac+", "ogg", "opus", "flac"};
@@ -573,6 +589,22 @@ void Configuration::setMaxStreams(int streams)
     }
 }
 
+void Configuration::setUpgradeSocket(const QString& path)
+{
+    if (m_upgradeSocket != path) {
+        m_upgradeSocket = path;
+        emit configurationChanged();
+    }
+}
+
+void Configuration::setUpgradeHandoffListeners(bool enabled)
+{
+    if (m_upgradeHandoffListeners != enabled) {
+        m_upgradeHandoffListeners = enabled;
+        emit configurationChanged();
+    }
+}
+
 // Stream configuration setters
 void Configuration::setDefaultLatency(int latency)
 {
@@ -755,6 +787,22 @@ void Configuration::setHlsPlaylistSize(int size)
     }
 }
 
+void Configuration::setHlsContainer(const QString& container)
+{
+    if (m_hlsContainer != container) {
+        m_hlsContainer = container;
+        emit configurationChanged();
+    }
+}
+
+void Configuration::setHlsPersistSegments(bool enabled)
+{
+    if (m_hlsPersistSegments != enabled) {
+        m_hlsPersistSegments = enabled;
+        emit configurationChanged();
+    }
+}
+
 // Codec configuration setters
 void Configuration::setEnabledCodecs(const QStringList& codecs)
 {
@@ -1005,6 +1053,7 @@ void Configuration::addMountPoint(const QString& mountPoint, const QString& prot
         defaultSettings["public"] = true;
         defaultSettings["maxListeners"] = 1000;
         defaultSettings["fallbackFile"] = "";
+        defaultSettings["dvrWindow"] = 0;
         defaultSettings["enabled"] = true;
         
         m_mountPoints[mountPoint] = defaultSettings;
@@ -1148,6 +1197,20 @@ void Configuration::setMountPointFallbackFile(const QString& mountPoint, const Q
     }
 }
 
+int Configuration::getMountPointDvrWindow(const QString& mountPoint) const
+{
+    return m_mountPoints.value(mountPoint).value("dvrWindow", 0).toInt();
+}
+
+void Configuration::setMountPointDvrWindow(const QString& mountPoint, int seconds)
+{
+    if (m_mountPoints.contains(mountPoint)) {
+        m_mountPoints[mountPoint]["dvrWindow"] = seconds;
+        emit mountPointUpdated(mountPoint);
+        emit configurationChanged();
+    }
+}
+
 bool Configuration::getMountPointEnabled(const QString& mountPoint) const
 {
     return m_mountPoints.value(mountPoint).value("enabled", true).toBool();
@@ -2,6 +2,7 @@
 #include "core/Configuration.h"
 #include "core/Logger.h"
 #include "core/PerformanceManager.h"
+#include "core/UpgradeHandoff.h"
 #include "streaming/HttpServer.h"
 #include "streaming/StreamManager.h"
 #include "streaming/RelayManager.h"
@@ -14,6 +15,7 @@
 // #include "protocols/IceCastServer.h"
 // #include "protocols/SHOUTcastServer.h"
 
+#include <QCoreApplication>
 #include <QLoggingCategory>
 #include <QTimer>
 #include <QDateTime>
@@ -33,6 +35,7 @@ ServerManager& ServerManager::instance()
 ServerManager::ServerManager()
     : QObject(nullptr)
     , m_statsTimer(new QTimer(this))
+    , m_reloadTimer(new QTimer(this))
     , m_startTime(QDateTime::currentSecsSinceEpoch())
     , m_networkManager(std::make_unique<QNetworkAccessManager>())
 {
@@ -99,7 +102,18 @@ void ServerManager::initializeComponents()
     
     // Initialize HLS generator
     m_hlsGenerator = std::make_unique<HLSGenerator>();
-    // m_hlsGenerator->setStreamManager(m_streamManager.get()); // Commented out for now
+    m_hlsGenerator->setSegmentDuration(config.hlsSegmentDuration());
+    m_hlsGenerator->setPlaylistLength(config.hlsPlaylistSize());
+    if (config.hlsContainer().compare("cmaf", Qt::CaseInsensitive) == 0) {
+        m_hlsGenerator->setContainer(HLSSegmenter::Container::CMAF);
+    }
+    // Latency targets below three segments need LL-HLS parts to be reachable
+    if (config.defaultLatency() < 3 * config.hlsSegmentDuration()) {
+        m_hlsGenerator->setPartDuration(qBound(200, config.defaultLatency() * 1000 / 6, 500));
+    }
+    m_hlsGenerator->setPersistSegments(config.hlsPersistSegments());
+    m_hlsGenerator->setStreamManager(m_streamManager.get());
+    m_httpServer->setHLSGenerator(m_hlsGenerator.get());
     
     // Initialize web interface
     m_webInterface = std::make_unique<WebInterface::WebInterface>();
@@ -137,11 +151,34 @@ void ServerManager::initializeComponents()
             });
     connect(m_httpServer.get(), &HttpServer::errorOccurred,
             this, &ServerManager::handleServerError);
+    connect(m_httpServer.get(), &HttpServer::drained,
+            this, &ServerManager::finishUpgrade);
+    
+    // Binary upgrade handoff
+    m_upgradeHandoff = std::make_unique<UpgradeHandoff>();
+    connect(m_upgradeHandoff.get(), &UpgradeHandoff::upgradeRequested,
+            this, &ServerManager::handOverToSuccessor);
+    connect(m_upgradeHandoff.get(), &UpgradeHandoff::error,
+            this, &ServerManager::handleServerError);
     
     connect(m_streamManager.get(), &StreamManager::streamConnected,
             this, &ServerManager::streamConnected);
     connect(m_streamManager.get(), &StreamManager::streamDisconnected,
             this, &ServerManager::streamDisconnected);
+
+    // Reload mounts when the configuration changes
+    m_reloadTimer->setSingleShot(true);
+    m_reloadTimer->setInterval(200);
+    connect(m_reloadTimer, &QTimer::timeout, this, [this]() {
+        if (m_isRunning.load()) {
+            reloadMounts();
+        }
+    });
+    auto scheduleReload = [this]() { m_reloadTimer->start(); };
+    connect(&config, &Configuration::configurationChanged, this, scheduleReload);
+    connect(&config, &Configuration::mountPointAdded, this, scheduleReload);
+    connect(&config, &Configuration::mountPointRemoved, this, scheduleReload);
+    connect(&config, &Configuration::mountPointUpdated, this, scheduleReload);
     
     // Connect web interface signals
     connect(m_webInterface.get(), &WebInterface::WebInterface::mountPointAdded,
@@ -182,6 +219,9 @@ bool ServerManager::startServers()
 
     auto& config = Configuration::instance();
     
+    // Take over the sockets of an older binary still running, if any
+    takeOverFromPredecessor();
+    
     // Start HTTP server
     if (!m_httpServer->start(config.httpPort())) {
         qCCritical(serverManager) << "Failed to start HTTP server";
@@ -212,6 +252,15 @@ bool ServerManager::startServers()
         m_hlsGenerator->start();
     }
     
+    // Start stream manager and create the configured mounts
+    m_streamManager->start();
+    reloadMounts();
+    
+    // Be ready to hand over to the next binary
+    if (!config.upgradeSocket().isEmpty()) {
+        m_upgradeHandoff->listen(config.upgradeSocket());
+    }
+    
     // Start statistics timer
     m_statsTimer->start();
     
@@ -235,6 +284,17 @@ void ServerManager::stopServers()
 
     // Stop statistics timer
     m_statsTimer->stop();
+    m_reloadTimer->stop();
+    
+    // No more handoffs
+    if (m_upgradeHandoff) {
+        m_upgradeHandoff->close();
+    }
+    
+    // Stop stream manager
+    if (m_streamManager) {
+        m_streamManager->stop();
+    }
     
     // Stop HLS generator
     if (m_hlsGenerator) {
@@ -282,6 +342,128 @@ void ServerManager::restartServers()
     startServers();
 }
 
+void ServerManager::takeOverFromPredecessor()
+{
+    const QString path = Configuration::instance().upgradeSocket();
+    if (path.isEmpty()) {
+        return;
+    }
+
+    UpgradeHandoff::State state;
+    QString error;
+    if (!UpgradeHandoff::receive(path, state, &error)) {
+        qDebug() << "No binary upgrade handoff:" << error;
+        return;
+    }
+
+    // The inherited listening socket wins over the configured port
+    if (state.listener >= 0) {
+        m_httpServer->adoptListener(state.listener);
+    }
+    for (const UpgradeHandoff::Cursor& cursor : state.cursors) {
+        m_hlsGenerator->resumeTimeline(cursor);
+    }
+
+    // Connections are adopted once the mounts exist, from the event loop
+    const QVector<UpgradeHandoff::Connection> connections = state.connections;
+    QTimer::singleShot(0, this, [this, connections]() {
+        int adopted = 0;
+        for (const UpgradeHandoff::Connection& connection : connections) {
+            if (m_httpServer && m_httpServer->adoptConnection(connection)) {
+                ++adopted;
+            }
+        }
+        qDebug() << "Adopted" << adopted << "of" << connections.size() << "listener connections";
+    });
+
+    qDebug() << "Took over from the previous binary:" << state.connections.size() << "connections,"
+             << state.cursors.size() << "timelines";
+}
+
+void ServerManager::handOverToSuccessor()
+{
+    if (!m_isRunning.load() || m_handedOver) {
+        return;
+    }
+
+    auto& config = Configuration::instance();
+    UpgradeHandoff::State state = m_httpServer->handoffState(config.upgradeHandoffListeners());
+    if (m_hlsGenerator) {
+        state.cursors = m_hlsGenerator->timelineCursors();
+    }
+
+    // On failure nothing changed hands and we carry on serving
+    if (!m_upgradeHandoff->handOver(state)) {
+        return;
+    }
+
+    m_handedOver = true;
+    m_httpServer->releaseHandoff(state);
+    QTimer::singleShot(UPGRADE_DRAIN_TIMEOUT, this, &ServerManager::finishUpgrade);
+    qDebug() << "Handed over to the new binary, draining";
+}
+
+void ServerManager::finishUpgrade()
+{
+    if (!m_handedOver) {
+        return;
+    }
+    m_handedOver = false;
+
+    qDebug() << "Upgrade handoff complete, exiting";
+    emit upgradeCompleted();
+    stopServers();
+    QCoreApplication::quit();
+}
+
+void ServerManager::reloadMounts()
+{
+    auto& config = Configuration::instance();
+
+    QSet<QString> wanted;
+    int added = 0;
+    int changed = 0;
+    for (const QString& mountPoint : config.mountPoints()) {
+        if (!config.getMountPointEnabled(mountPoint)) {
+            continue;
+        }
+        wanted.insert(mountPoint);
+
+        const QString codec = config.getMountPointCodec(mountPoint);
+        const int bitrate = config.getMountPointBitrate(mountPoint);
+        if (!m_streamManager->hasStream(mountPoint)) {
+            m_streamManager->addStream(mountPoint, codec, bitrate);
+            ++added;
+        } else {
+            const StreamInfo info = m_streamManager->getStreamInfo(mountPoint);
+            if (info.codec != codec || info.bitrate != bitrate || info.draining) {
+                m_streamManager->reconfigureStream(mountPoint, codec, bitrate);
+                ++changed;
+            }
+            m_streamManager->refreshFallback(mountPoint);
+        }
+
+        if (m_hlsGenerator) {
+            m_hlsGenerator->setDvrWindow(mountPoint, config.getMountPointDvrWindow(mountPoint));
+        }
+    }
+
+    // Only mounts that came from the configuration are drained; streams
+    // created elsewhere are left alone
+    int drained = 0;
+    for (const QString& mountPoint : m_configuredMounts) {
+        if (!wanted.contains(mountPoint) && m_streamManager->hasStream(mountPoint)) {
+            m_streamManager->drainStream(mountPoint, MOUNT_DRAIN_TIMEOUT);
+            ++drained;
+        }
+    }
+    m_configuredMounts = wanted;
+
+    if (added || changed || drained) {
+        qDebug() << "Mounts reloaded:" << added << "added," << changed << "changed," << drained << "draining";
+    }
+}
+
 void ServerManager::shutdown()
 {
     if (m_isRunning.load()) {
@@ -293,6 +475,7 @@ void ServerManager::shutdown()
     perfManager.stopResourceMonitoring();
     
     // Clean up components
+    m_upgradeHandoff.reset();
     m_webInterface.reset();
     m_statisticRelayManager.reset();
     m_hlsGenerator.reset();
@@ -0,0 +1,474 @@
+#include "core/UpgradeHandoff.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSocketNotifier>
+#include <QtEndian>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace LegacyStream {
+
+namespace {
+
+const char ACK = 'A';      // successor: everything received
+const char RELEASED = 'R'; // old process: descriptors and path let go
+
+#ifdef Q_OS_LINUX
+bool makeAddress(const QString& path, sockaddr_un& address)
+{
+    const QByteArray encoded = QFile::encodeName(path);
+    if (encoded.isEmpty() || encoded.size() >= static_cast<int>(sizeof(address.sun_path))) {
+        return false;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, encoded.constData(), static_cast<size_t>(encoded.size()));
+    return true;
+}
+
+void setTimeouts(int fd)
+{
+    timeval timeout;
+    timeout.tv_sec = UpgradeHandoff::TIMEOUT / 1000;
+    timeout.tv_usec = (UpgradeHandoff::TIMEOUT % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+bool writeAll(int fd, const char* data, size_t length)
+{
+    while (length > 0) {
+        const ssize_t written = ::send(fd, data, length, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool readAll(int fd, char* data, size_t length)
+{
+    while (length > 0) {
+        const ssize_t received = ::recv(fd, data, length, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        length -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+int connectTo(const QString& path)
+{
+    sockaddr_un address;
+    if (!makeAddress(path, address)) {
+        return -1;
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+#endif
+
+void closeAll(const QVector<int>& fds)
+{
+#ifdef Q_OS_LINUX
+    for (int fd : fds) {
+        ::close(fd);
+    }
+#else
+    Q_UNUSED(fds)
+#endif
+}
+
+} // namespace
+
+UpgradeHandoff::UpgradeHandoff(QObject* parent)
+    : QObject(parent)
+{
+}
+
+UpgradeHandoff::~UpgradeHandoff()
+{
+    close();
+}
+
+bool UpgradeHandoff::listen(const QString& path)
+{
+    close();
+
+#ifdef Q_OS_LINUX
+    sockaddr_un address;
+    if (!makeAddress(path, address)) {
+        emit error(QString("Invalid upgrade socket path %1").arg(path));
+        return false;
+    }
+
+    // Only a leftover from a dead process may be replaced
+    const int live = connectTo(path);
+    if (live >= 0) {
+        ::close(live);
+        emit error(QString("Upgrade socket %1 is in use by another process").arg(path));
+        return false;
+    }
+    ::unlink(address.sun_path);
+
+    m_server = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_server < 0 || ::bind(m_server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(m_server, 1) != 0) {
+        emit error(QString("Cannot listen on upgrade socket %1: %2").arg(path, QString::fromLocal8Bit(strerror(errno))));
+        close();
+        return false;
+    }
+    // Whoever connects gets every listener's socket
+    ::chmod(address.sun_path, S_IRUSR | S_IWUSR);
+
+    m_path = path;
+    m_notifier = new QSocketNotifier(m_server, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &UpgradeHandoff::onPeerConnected);
+    qDebug() << "UpgradeHandoff: Listening on" << path;
+    return true;
+#else
+    emit error(QString("Binary upgrade handoff is not supported on this platform (%1)").arg(path));
+    return false;
+#endif
+}
+
+void UpgradeHandoff::close()
+{
+    // Also called from a slot of the notifier itself
+    if (m_notifier) {
+        m_notifier->setEnabled(false);
+        m_notifier->deleteLater();
+        m_notifier = nullptr;
+    }
+
+#ifdef Q_OS_LINUX
+    if (m_peer >= 0) {
+        ::close(m_peer);
+        m_peer = -1;
+    }
+    if (m_server >= 0) {
+        ::close(m_server);
+        m_server = -1;
+        ::unlink(QFile::encodeName(m_path).constData());
+    }
+#endif
+    m_path.clear();
+}
+
+void UpgradeHandoff::onPeerConnected()
+{
+#ifdef Q_OS_LINUX
+    const int peer = ::accept4(m_server, nullptr, nullptr, SOCK_CLOEXEC);
+    if (peer < 0) {
+        return;
+    }
+    if (m_peer >= 0) {
+        ::close(peer); // one successor at a time
+        return;
+    }
+
+    setTimeouts(peer);
+    m_peer = peer;
+    qDebug() << "UpgradeHandoff: Successor connected";
+    emit upgradeRequested();
+
+    // Not answered (or not taken over): let the next successor try
+    if (m_peer >= 0) {
+        ::close(m_peer);
+        m_peer = -1;
+    }
+#endif
+}
+
+bool UpgradeHandoff::handOver(const State& state)
+{
+#ifdef Q_OS_LINUX
+    if (m_peer < 0) {
+        return false;
+    }
+
+    QJsonArray cursors;
+    for (const Cursor& cursor : state.cursors) {
+        QJsonObject entry;
+        entry["mountPoint"] = cursor.mountPoint;
+        entry["nextSequence"] = cursor.nextSequence;
+        entry["position"] = cursor.position;
+        cursors.append(entry);
+    }
+
+    // The listening socket and cursors ride in the first frame, the
+    // connections follow in frames of at most MAX_FDS_PER_FRAME
+    bool ok = true;
+    int next = 0;
+    bool first = true;
+    while (ok && (first || next < state.connections.size())) {
+        QJsonObject frame;
+        QVector<int> fds;
+        if (first) {
+            frame["cursors"] = cursors;
+            if (state.listener >= 0) {
+                frame["listener"] = true;
+                fds.append(static_cast<int>(state.listener));
+            }
+        }
+
+        QJsonArray connections;
+        while (next < state.connections.size() && fds.size() < MAX_FDS_PER_FRAME) {
+            const Connection& connection = state.connections.at(next++);
+            QJsonObject entry;
+            entry["mountPoint"] = connection.mountPoint;
+            entry["pending"] = QString::fromLatin1(connection.pending.toBase64());
+            entry["userAgentHash"] = static_cast<qint64>(connection.userAgentHash);
+            entry["connectTime"] = connection.connectTime;
+            entry["bytesSent"] = connection.bytesSent;
+            connections.append(entry);
+            fds.append(static_cast<int>(connection.descriptor));
+        }
+        frame["connections"] = connections;
+        frame["last"] = next >= state.connections.size();
+
+        ok = sendFrame(m_peer, QJsonDocument(frame).toJson(QJsonDocument::Compact), fds);
+        first = false;
+    }
+
+    char reply = 0;
+    if (!ok || !readAll(m_peer, &reply, 1) || reply != ACK) {
+        emit error("Upgrade handoff failed: successor did not take over");
+        return false;
+    }
+
+    // Free the path for the successor's own upgrade socket, then confirm
+    const QString path = m_path;
+    const int peer = m_peer;
+    m_peer = -1;
+    close();
+    const bool released = writeAll(peer, &RELEASED, 1);
+    ::close(peer);
+    if (!released) {
+        // The successor is gone and will drop what it received
+        emit error("Upgrade handoff failed: successor disappeared");
+        listen(path);
+        return false;
+    }
+
+    qDebug() << "UpgradeHandoff: Handed over" << state.connections.size() << "connections and"
+             << state.cursors.size() << "timelines";
+    return true;
+#else
+    Q_UNUSED(state)
+    return false;
+#endif
+}
+
+bool UpgradeHandoff::receive(const QString& path, State& state, QString* error)
+{
+#ifdef Q_OS_LINUX
+    const int fd = connectTo(path);
+    if (fd < 0) {
+        if (error) {
+            *error = QString("No running server on %1").arg(path);
+        }
+        return false;
+    }
+    setTimeouts(fd);
+
+    State received;
+    QVector<int> all;
+    bool ok = true;
+    bool last = false;
+    while (ok && !last) {
+        QByteArray body;
+        QVector<int> fds;
+        ok = receiveFrame(fd, body, fds);
+        all += fds;
+
+        const QJsonObject frame = QJsonDocument::fromJson(body).object();
+        const QJsonArray connections = frame.value("connections").toArray();
+        const int expected = connections.size() + (frame.value("listener").toBool() ? 1 : 0);
+        if (!ok || frame.isEmpty() || fds.size() != expected) {
+            ok = false;
+            break;
+        }
+
+        int index = 0;
+        if (frame.value("listener").toBool()) {
+            received.listener = fds.at(index++);
+        }
+        for (const QJsonValue& value : frame.value("cursors").toArray()) {
+            const QJsonObject entry = value.toObject();
+            Cursor cursor;
+            cursor.mountPoint = entry.value("mountPoint").toString();
+            cursor.nextSequence = static_cast<qint64>(entry.value("nextSequence").toDouble());
+            cursor.position = entry.value("position").toDouble();
+            received.cursors.append(cursor);
+        }
+        for (const QJsonValue& value : connections) {
+            const QJsonObject entry = value.toObject();
+            Connection connection;
+            connection.descriptor = fds.at(index++);
+            connection.mountPoint = entry.value("mountPoint").toString();
+            connection.pending = QByteArray::fromBase64(entry.value("pending").toString().toLatin1());
+            connection.userAgentHash = static_cast<quint32>(entry.value("userAgentHash").toDouble());
+            connection.connectTime = static_cast<qint64>(entry.value("connectTime").toDouble());
+            connection.bytesSent = static_cast<qint64>(entry.value("bytesSent").toDouble());
+            received.connections.append(connection);
+        }
+        last = frame.value("last").toBool();
+    }
+
+    // Only a released handoff is ours; otherwise the old process still
+    // owns these sockets
+    char reply = 0;
+    if (!ok || !writeAll(fd, &ACK, 1) || !readAll(fd, &reply, 1) || reply != RELEASED) {
+        ::close(fd);
+        closeAll(all);
+        if (error) {
+            *error = QString("Handoff from %1 failed").arg(path);
+        }
+        return false;
+    }
+
+    ::close(fd);
+    state = received;
+    return true;
+#else
+    Q_UNUSED(state)
+    if (error) {
+        *error = QString("Binary upgrade handoff is not supported on this platform (%1)").arg(path);
+    }
+    return false;
+#endif
+}
+
+bool UpgradeHandoff::sendFrame(int fd, const QByteArray& body, const QVector<int>& fds)
+{
+#ifdef Q_OS_LINUX
+    // The descriptors are attached to the length, which is read with a
+    // single recvmsg() on the other end
+    uchar header[4];
+    qToBigEndian(static_cast<quint32>(body.size()), header);
+
+    iovec io;
+    io.iov_base = header;
+    io.iov_len = sizeof(header);
+
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+
+    QByteArray control;
+    if (!fds.isEmpty()) {
+        const size_t payload = sizeof(int) * static_cast<size_t>(fds.size());
+        control.fill(0, static_cast<int>(CMSG_SPACE(payload)));
+        message.msg_control = control.data();
+        message.msg_controllen = static_cast<size_t>(control.size());
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(payload);
+        memcpy(CMSG_DATA(cmsg), fds.constData(), payload);
+    }
+
+    ssize_t sent;
+    do {
+        sent = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent <= 0) {
+        return false;
+    }
+    const size_t rest = sizeof(header) - static_cast<size_t>(sent);
+    return writeAll(fd, reinterpret_cast<const char*>(header) + sent, rest) &&
+           writeAll(fd, body.constData(), static_cast<size_t>(body.size()));
+#else
+    Q_UNUSED(fd)
+    Q_UNUSED(body)
+    Q_UNUSED(fds)
+    return false;
+#endif
+}
+
+bool UpgradeHandoff::receiveFrame(int fd, QByteArray& body, QVector<int>& fds)
+{
+#ifdef Q_OS_LINUX
+    uchar header[4];
+    iovec io;
+    io.iov_base = header;
+    io.iov_len = sizeof(header);
+
+    QByteArray control(static_cast<int>(CMSG_SPACE(sizeof(int) * MAX_FDS_PER_FRAME)), 0);
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = static_cast<size_t>(control.size());
+
+    ssize_t received;
+    do {
+        received = ::recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0) {
+        return false;
+    }
+
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            const int count = static_cast<int>((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            const int offset = fds.size();
+            fds.resize(offset + count);
+            memcpy(fds.data() + offset, CMSG_DATA(cmsg), sizeof(int) * static_cast<size_t>(count));
+        }
+    }
+    if (message.msg_flags & MSG_CTRUNC) {
+        return false; // some descriptors were lost; the caller closes the rest
+    }
+
+    const size_t rest = sizeof(header) - static_cast<size_t>(received);
+    if (!readAll(fd, reinterpret_cast<char*>(header) + received, rest)) {
+        return false;
+    }
+    const quint32 length = qFromBigEndian<quint32>(header);
+    if (length > 64 * 1024 * 1024) {
+        return false;
+    }
+    body.resize(static_cast<int>(length));
+    return readAll(fd, body.data(), length);
+#else
+    Q_UNUSED(fd)
+    Q_UNUSED(body)
+    Q_UNUSED(fds)
+    return false;
+#endif
+}
+
+} // namespace LegacyStream
@@ -0,0 +1,394 @@
+#include "streaming/AudioFrameParser.h"
+
+#include <cstring>
+
+namespace LegacyStream {
+
+namespace {
+
+const int MP3_BITRATES_V1[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+const int MP3_BITRATES_V2[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+const int MP3_SAMPLE_RATES[3] = {44100, 48000, 32000};
+const int ADTS_SAMPLE_RATES[16] = {96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050,
+                                   16000, 12000, 11025, 8000, 7350, 0, 0, 0};
+
+class BitReader
+{
+public:
+    BitReader(const uchar* data) : m_data(data) {}
+
+    quint32 read(int bits)
+    {
+        quint32 value = 0;
+        for (int i = 0; i < bits; ++i) {
+            const int byte = m_pos >> 3;
+            const int shift = 7 - (m_pos & 7);
+            value = (value << 1) | ((m_data[byte] >> shift) & 1);
+            ++m_pos;
+        }
+        return value;
+    }
+
+    void skip(int bits) { m_pos += bits; }
+
+private:
+    const uchar* m_data;
+    int m_pos = 0;
+};
+
+} // namespace
+
+AudioFrameParser::Codec AudioFrameParser::codecFromString(const QString& codec)
+{
+    const QString name = codec.toLower();
+    if (name == "mp3" || name == "mpeg" || name == "audio/mpeg") {
+        return Codec::MP3;
+    }
+    if (name == "aac" || name == "aac+" || name == "audio/aac" || name == "audio/aacp") {
+        return Codec::AAC_ADTS;
+    }
+    if (name == "opus" || name == "ogg" || name == "audio/ogg" || name == "audio/opus") {
+        return Codec::OGG_OPUS;
+    }
+    return Codec::UNKNOWN;
+}
+
+AudioFrameParser::Result AudioFrameParser::parse(Codec codec, const uchar* data, qint64 available, AudioFrameInfo& info)
+{
+    switch (codec) {
+        case Codec::MP3:
+            return parseMp3(data, available, info);
+        case Codec::AAC_ADTS:
+            return parseAdts(data, available, info);
+        case Codec::OGG_OPUS:
+            return parseOggOpus(data, available, info);
+        default:
+            return Result::NoSync;
+    }
+}
+
+AudioFrameParser::Result AudioFrameParser::parseMp3(const uchar* p, qint64 available, AudioFrameInfo& info)
+{
+    if (available < 4) {
+        return (available >= 1 && p[0] == 0xFF) ? Result::NeedMoreData : Result::NoSync;
+    }
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) {
+        return Result::NoSync;
+    }
+
+    const int version = (p[1] >> 3) & 3;  // 0: 2.5, 2: 2, 3: 1
+    const int layer = (p[1] >> 1) & 3;    // 1: Layer III
+    const bool hasCrc = !(p[1] & 1);
+    const int bitrateIndex = p[2] >> 4;
+    const int rateIndex = (p[2] >> 2) & 3;
+    const int padding = (p[2] >> 1) & 1;
+    const bool mono = (p[3] >> 6) == 3;
+
+    if (version == 1 || layer != 1 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3) {
+        return Result::NoSync;
+    }
+
+    const bool mpeg1 = version == 3;
+    int sampleRate = MP3_SAMPLE_RATES[rateIndex];
+    if (version == 2) {
+        sampleRate /= 2;
+    } else if (version == 0) {
+        sampleRate /= 4;
+    }
+
+    const int bitrate = mpeg1 ? MP3_BITRATES_V1[bitrateIndex] : MP3_BITRATES_V2[bitrateIndex];
+    const int channels = mono ? 1 : 2;
+    const int sideInfo = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+
+    info.length = (mpeg1 ? 144 : 72) * bitrate * 1000 / sampleRate + padding;
+    info.samples = mpeg1 ? 1152 : 576;
+    info.sampleRate = sampleRate;
+    info.channels = channels;
+    info.bitrate = bitrate;
+    info.headerBytes = 4 + (hasCrc ? 2 : 0) + sideInfo;
+
+    if (info.length <= info.headerBytes) {
+        return Result::NoSync;
+    }
+    if (available < info.headerBytes) {
+        return Result::NeedMoreData;
+    }
+
+    // Side info: part2_3_length is the number of main-data bits actually
+    // coded for each granule and channel. Silent granules code next to none.
+    BitReader bits(p + 4 + (hasCrc ? 2 : 0));
+    const int granules = mpeg1 ? 2 : 1;
+    quint32 usedBits = 0;
+
+    if (mpeg1) {
+        bits.skip(9);                  // main_data_begin
+        bits.skip(mono ? 5 : 3);       // private bits
+        bits.skip(4 * channels);       // scfsi
+    } else {
+        bits.skip(8);
+        bits.skip(mono ? 1 : 2);
+    }
+
+    for (int gr = 0; gr < granules; ++gr) {
+        for (int ch = 0; ch < channels; ++ch) {
+            usedBits += bits.read(12);
+            bits.skip(mpeg1 ? 47 : 51); // rest of the granule info
+        }
+    }
+
+    const qint64 payloadBits = (info.length - info.headerBytes) * 8;
+    info.mainDataRatio = static_cast<double>(usedBits) / payloadBits;
+    return Result::Frame;
+}
+
+AudioFrameParser::Result AudioFrameParser::parseAdts(const uchar* p, qint64 available, AudioFrameInfo& info)
+{
+    if (available < 7) {
+        return (available >= 1 && p[0] == 0xFF) ? Result::NeedMoreData : Result::NoSync;
+    }
+    if (p[0] != 0xFF || (p[1] & 0xF6) != 0xF0) {
+        return Result::NoSync;
+    }
+
+    const bool protectionAbsent = p[1] & 1;
+    const int rateIndex = (p[2] >> 2) & 0xF;
+    const int channelConfig = ((p[2] & 1) << 2) | (p[3] >> 6);
+    const qint64 frameLength = ((p[3] & 3) << 11) | (p[4] << 3) | (p[5] >> 5);
+    const int rawBlocks = (p[6] & 3) + 1;
+    const int headerBytes = protectionAbsent ? 7 : 9;
+
+    if (ADTS_SAMPLE_RATES[rateIndex] == 0 || frameLength <= headerBytes) {
+        return Result::NoSync;
+    }
+
+    info.length = frameLength;
+    info.samples = 1024 * rawBlocks;
+    info.sampleRate = ADTS_SAMPLE_RATES[rateIndex];
+    info.channels = channelConfig == 7 ? 8 : channelConfig;
+    info.bitrate = 0;
+    info.headerBytes = headerBytes;
+    info.mainDataRatio = 1.0;
+    return Result::Frame;
+}
+
+AudioFrameParser::Result AudioFrameParser::parseOggOpus(const uchar* p, qint64 available, AudioFrameInfo& info)
+{
+    static const char CAPTURE[] = "OggS";
+    for (int i = 0; i < 4 && i < available; ++i) {
+        if (p[i] != uchar(CAPTURE[i])) {
+            return Result::NoSync;
+        }
+    }
+    if (available < 27) {
+        return Result::NeedMoreData;
+    }
+    if (p[4] != 0) {
+        return Result::NoSync; // stream structure version
+    }
+
+    const int segments = p[26];
+    const int headerBytes = 27 + segments;
+    if (available < headerBytes) {
+        return Result::NeedMoreData;
+    }
+
+    qint64 length = headerBytes;
+    for (int i = 0; i < segments; ++i) {
+        length += p[27 + i];
+    }
+    // The duration comes from the packets, so the whole page is needed
+    if (available < length) {
+        return Result::NeedMoreData;
+    }
+
+    int samples = 0;
+    for (const OggPacket& packet : oggPackets(p, length)) {
+        samples += opusPacketSamples(p + packet.offset, packet.length);
+    }
+
+    info.length = length;
+    info.samples = samples;
+    info.sampleRate = 48000; // Opus always decodes at 48 kHz
+    info.channels = 0;       // only known from the OpusHead packet
+    info.bitrate = 0;
+    info.headerBytes = headerBytes;
+    info.mainDataRatio = 1.0;
+    return Result::Frame;
+}
+
+QVector<OggPacket> AudioFrameParser::oggPackets(const uchar* page, qint64 length, bool includeContinued)
+{
+    QVector<OggPacket> packets;
+    const int segments = page[26];
+    qint64 offset = 27 + segments;
+    bool skip = isOggContinued(page) && !includeContinued;
+
+    OggPacket packet;
+    packet.offset = offset;
+    for (int i = 0; i < segments; ++i) {
+        const int lacing = page[27 + i];
+        packet.length += lacing;
+        offset += lacing;
+        if (lacing < 255) {
+            // A lacing value below 255 ends the packet
+            if (!skip) {
+                packets.append(packet);
+            }
+            skip = false;
+            packet = OggPacket();
+            packet.offset = offset;
+        }
+    }
+
+    if (packet.length > 0 && !skip && packet.offset + packet.length <= length) {
+        packet.complete = false;
+        packets.append(packet);
+    }
+    return packets;
+}
+
+int AudioFrameParser::opusPacketSamples(const uchar* packet, qint64 length)
+{
+    // Header packets carry no audio
+    if (length < 1 || (length >= 8 && (memcmp(packet, "OpusHead", 8) == 0 || memcmp(packet, "OpusTags", 8) == 0))) {
+        return 0;
+    }
+
+    // RFC 6716 3.1: the TOC config selects the frame size, the low bits
+    // the frame count
+    const int config = packet[0] >> 3;
+    int frameSize;
+    if (config < 12) {
+        static const int SILK[4] = {480, 960, 1920, 2880};
+        frameSize = SILK[config & 3];
+    } else if (config < 16) {
+        frameSize = (config & 1) ? 960 : 480;
+    } else {
+        static const int CELT[4] = {120, 240, 480, 960};
+        frameSize = CELT[config & 3];
+    }
+
+    int frames;
+    switch (packet[0] & 3) {
+        case 0:
+            frames = 1;
+            break;
+        case 1:
+        case 2:
+            frames = 2;
+            break;
+        default:
+            frames = length >= 2 ? (packet[1] & 0x3F) : 0;
+            break;
+    }
+    return frames * frameSize;
+}
+
+qint64 AudioFrameParser::findFrameStart(Codec codec, const uchar* data, qint64 size, qint64 from)
+{
+    AudioFrameInfo info;
+    AudioFrameInfo next;
+    const uchar syncByte = codec == Codec::OGG_OPUS ? 'O' : 0xFF;
+
+    for (qint64 pos = qMax<qint64>(0, from); pos < size; ++pos) {
+        if (data[pos] != syncByte) {
+            continue;
+        }
+        if (codec == Codec::OGG_OPUS) {
+            // Pages are found by their capture pattern; a page cut off by
+            // the end of the buffer is still a start
+            const auto result = parse(codec, data + pos, size - pos, info);
+            if (result == Result::Frame || result == Result::NeedMoreData) {
+                return pos;
+            }
+            continue;
+        }
+        if (parse(codec, data + pos, size - pos, info) != Result::Frame) {
+            continue;
+        }
+
+        const qint64 following = pos + info.length;
+        if (following + 4 > size) {
+            return pos;
+        }
+        if (parse(codec, data + following, size - following, next) != Result::NoSync &&
+            next.sampleRate == info.sampleRate) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+AudioFrameAligner::AudioFrameAligner(AudioFrameParser::Codec codec)
+    : m_codec(codec)
+{
+}
+
+void AudioFrameAligner::setCodec(AudioFrameParser::Codec codec)
+{
+    m_codec = codec;
+    reset();
+}
+
+void AudioFrameAligner::reset()
+{
+    m_pending.clear();
+    m_synced = false;
+}
+
+QByteArray AudioFrameAligner::push(const QByteArray& data, qint64* samples)
+{
+    if (samples) {
+        *samples = 0;
+    }
+    if (m_codec == AudioFrameParser::Codec::UNKNOWN) {
+        return data;
+    }
+
+    m_pending.append(data);
+    const uchar* p = reinterpret_cast<const uchar*>(m_pending.constData());
+    const qint64 size = m_pending.size();
+
+    qint64 start = 0;
+    if (!m_synced) {
+        start = AudioFrameParser::findFrameStart(m_codec, p, size);
+        if (start < 0) {
+            // Nothing that looks like audio yet; keep only a possible header prefix
+            if (size > MAX_UNSYNCED_BYTES) {
+                m_pending = m_pending.right(8);
+            }
+            return QByteArray();
+        }
+        m_synced = true;
+    }
+
+    AudioFrameInfo info;
+    qint64 end = start;
+    while (end < size) {
+        const auto result = AudioFrameParser::parse(m_codec, p + end, size - end, info);
+        if (result == AudioFrameParser::Result::NoSync) {
+            // Lost sync mid-stream: emit what we have and resync on the rest
+            m_synced = false;
+            break;
+        }
+        if (result == AudioFrameParser::Result::NeedMoreData || end + info.length > size) {
+            break;
+        }
+        end += info.length;
+        if (samples) {
+            *samples += info.samples;
+        }
+    }
+
+    QByteArray frames;
+    if (start == 0 && end == size) {
+        frames = m_pending;
+        m_pending.clear();
+    } else {
+        frames = m_pending.mid(start, end - start);
+        m_pending.remove(0, end);
+    }
+    return frames;
+}
+
+} // namespace LegacyStream
@@ -78,6 +78,9 @@ bool AudioProcessor::initialize()
         qDebug() << "Using output device:" << m_outputDevice.deviceName();
     }
     
+    // Build the shared filter banks for the usual broadcast rate pairs up front
+    Resampler::precomputeCommonRatios();
+    
     qDebug() << "AudioProcessor initialized successfully";
     return true;
 }
@@ -99,6 +102,8 @@ void AudioProcessor::shutdown()
     m_effectBuffers.clear();
     m_lastAnalysis.clear();
     m_analysisHistory.clear();
+    m_loudnessMeters.clear();
+    m_resamplers.clear();
     m_syncInfo.clear();
     m_synchronizedStreams.clear();
     m_qualitySettings.clear();
@@ -557,6 +562,7 @@ AudioAnalysis AudioProcessor::analyzeAudio(const QByteArray& audioData, const QS
     analysis.mfcc = calculateMFCC(audioData);
     analysis.isClipping = detectClipping(audioData);
     analysis.snr = calculateSNR(audioData);
+    analysis.loudness = updateLoudness(audioData, streamId);
     
     // Store analysis
     m_lastAnalysis[streamId] = analysis;
@@ -677,6 +683,69 @@ QMap<int, double> AudioProcessor::calculateMFCC(const QByteArray& audioData)
     return mfcc;
 }
 
+LoudnessMeasurement AudioProcessor::updateLoudness(const QByteArray& audioData, const QString& streamId)
+{
+    QMutexLocker locker(&m_mutex);
+    
+    // Meters keep filter and gating state across chunks, one per stream
+    std::shared_ptr<LoudnessMeter>& meter = m_loudnessMeters[streamId];
+    if (!meter || meter->sampleRate() != m_sampleRate || meter->channels() != m_channels) {
+        meter = std::make_shared<LoudnessMeter>(m_sampleRate, m_channels);
+    }
+    
+    // Interleaved signed 16-bit PCM in host byte order
+    const qint64 frames = audioData.size() / (static_cast<qint64>(sizeof(qint16)) * m_channels);
+    meter->process(reinterpret_cast<const qint16*>(audioData.constData()), frames);
+    
+    return meter->measurement();
+}
+
+LoudnessMeasurement AudioProcessor::getLoudness(const QString& streamId) const
+{
+    QMutexLocker locker(&m_mutex);
+    const std::shared_ptr<LoudnessMeter> meter = m_loudnessMeters.value(streamId);
+    return meter ? meter->measurement() : LoudnessMeasurement();
+}
+
+void AudioProcessor::resetLoudness(const QString& streamId)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_loudnessMeters.contains(streamId)) {
+        m_loudnessMeters[streamId]->reset();
+        qDebug() << "Reset loudness measurement for stream:" << streamId;
+    }
+}
+
+void AudioProcessor::checkLoudnessCompliance(const QString& streamId)
+{
+    const std::shared_ptr<LoudnessMeter> meter = m_loudnessMeters.value(streamId);
+    if (!meter) {
+        return;
+    }
+    
+    // EBU R128 defaults: -23 LUFS target, +/-1 LU tolerance, -1 dBTP ceiling
+    const QJsonObject settings = m_qualitySettings.value(streamId);
+    const double targetLoudness = settings.value("target_loudness").toDouble(-23.0);
+    const double tolerance = settings.value("loudness_tolerance").toDouble(1.0);
+    const double maxTruePeak = settings.value("max_true_peak").toDouble(-1.0);
+    const double minDuration = settings.value("min_integration_time").toDouble(10.0);
+    
+    const LoudnessMeasurement loudness = meter->measurement();
+    
+    if (loudness.truePeak > maxTruePeak) {
+        emit qualityAlert(streamId, QString("True peak %1 dBTP exceeds %2 dBTP")
+                          .arg(loudness.truePeak, 0, 'f', 1).arg(maxTruePeak, 0, 'f', 1));
+    }
+    
+    if (loudness.integratedDuration >= minDuration &&
+        qAbs(loudness.integratedLoudness - targetLoudness) > tolerance) {
+        emit qualityAlert(streamId, QString("Integrated loudness %1 LUFS outside target %2 +/- %3 LU")
+                          .arg(loudness.integratedLoudness, 0, 'f', 1)
+                          .arg(targetLoudness, 0, 'f', 1)
+                          .arg(tolerance, 0, 'f', 1));
+    }
+}
+
 bool AudioProcessor::detectClipping(const QByteArray& audioData)
 {
     QDataStream inStream(audioData);
@@ -741,6 +810,11 @@ QJsonObject AudioProcessor::getAnalysisJson(const AudioAnalysis& analysis) const
     json["zero_crossing_rate"] = analysis.zeroCrossingRate;
     json["is_clipping"] = analysis.isClipping;
     json["snr"] = analysis.snr;
+    json["momentary_loudness"] = analysis.loudness.momentaryLoudness;
+    json["short_term_loudness"] = analysis.loudness.shortTermLoudness;
+    json["integrated_loudness"] = analysis.loudness.integratedLoudness;
+    json["loudness_range"] = analysis.loudness.loudnessRange;
+    json["true_peak"] = analysis.loudness.truePeak;
     json["timestamp"] = analysis.timestamp.toString(Qt::ISODate);
     
     return json;
@@ -762,25 +836,66 @@ bool AudioProcessor::isRealTimeAnalysisEnabled(const QString& streamId) const
 QByteArray AudioProcessor::convertFormat(const QByteArray& audioData, const QString& fromFormat, 
                                         const QString& toFormat, const AudioFormatInfo& targetFormat)
 {
-    QByteArray convertedData = audioData;
+    // Rate, channel and bit depth conversion happen in one pass over the data
+    PcmFormat source;
+    source.sampleRate = m_sampleRate;
+    source.channels = m_channels;
+    source.bitDepth = m_bitDepth;
     
-    // Resample if needed
-    if (targetFormat.sampleRate != m_sampleRate) {
-        convertedData = resampleAudio(convertedData, m_sampleRate, targetFormat.sampleRate);
-    }
+    QByteArray convertedData = Resampler::convert(audioData, source, toPcmFormat(targetFormat));
+    
+    emit formatConverted("", fromFormat, toFormat);
+    return convertedData;
+}
+
+QByteArray AudioProcessor::convertStream(const QByteArray& audioData, const QString& streamId,
+                                        const AudioFormatInfo& sourceFormat, const AudioFormatInfo& targetFormat)
+{
+    const PcmFormat source = toPcmFormat(sourceFormat);
+    const PcmFormat target = toPcmFormat(targetFormat);
     
-    // Convert channels if needed
-    if (targetFormat.channels != m_channels) {
-        convertedData = convertChannels(convertedData, m_channels, targetFormat.channels);
+    if (source == target) {
+        return audioData;
     }
     
-    // Convert bit depth if needed
-    if (targetFormat.bitDepth != m_bitDepth) {
-        convertedData = convertBitDepth(convertedData, m_bitDepth, targetFormat.bitDepth);
+    std::shared_ptr<Resampler> resampler;
+    {
+        QMutexLocker locker(&m_mutex);
+        std::shared_ptr<Resampler>& entry = m_resamplers[streamId];
+        if (!entry || entry->inputFormat() != source || entry->outputFormat() != target) {
+            entry = std::make_shared<Resampler>();
+            if (!entry->configure(source, target)) {
+                m_resamplers.remove(streamId);
+                emit processingError(streamId, "Unsupported PCM format conversion");
+                return QByteArray();
+            }
+        }
+        resampler = entry;
+        m_formatConversions[streamId]++;
     }
     
-    emit formatConverted("", fromFormat, toFormat);
-    return convertedData;
+    // Filter state carries across chunks, so the caller must feed one stream
+    // from one thread at a time
+    return resampler->process(audioData);
+}
+
+QByteArray AudioProcessor::flushStreamConversion(const QString& streamId)
+{
+    std::shared_ptr<Resampler> resampler;
+    {
+        QMutexLocker locker(&m_mutex);
+        resampler = m_resamplers.take(streamId);
+    }
+    return resampler ? resampler->flush() : QByteArray();
+}
+
+PcmFormat AudioProcessor::toPcmFormat(const AudioFormatInfo& format)
+{
+    PcmFormat pcm;
+    pcm.sampleRate = format.sampleRate;
+    pcm.channels = format.channels;
+    pcm.bitDepth = format.bitDepth;
+    return pcm;
 }
 
 AudioFormatInfo AudioProcessor::detectFormat(const QByteArray& audioData)
@@ -955,20 +1070,41 @@ void AudioProcessor::resetStats()
 
 QByteArray AudioProcessor::resampleAudio(const QByteArray& audioData, int fromSampleRate, int toSampleRate)
 {
-    // Simplified resampling implementation
-    return audioData; // Placeholder
+    PcmFormat from;
+    from.sampleRate = fromSampleRate;
+    from.channels = m_channels;
+    from.bitDepth = m_bitDepth;
+    
+    PcmFormat to = from;
+    to.sampleRate = toSampleRate;
+    
+    return Resampler::convert(audioData, from, to);
 }
 
 QByteArray AudioProcessor::convertChannels(const QByteArray& audioData, int fromChannels, int toChannels)
 {
-    // Simplified channel conversion implementation
-    return audioData; // Placeholder
+    PcmFormat from;
+    from.sampleRate = m_sampleRate;
+    from.channels = fromChannels;
+    from.bitDepth = m_bitDepth;
+    
+    PcmFormat to = from;
+    to.channels = toChannels;
+    
+    return Resampler::convert(audioData, from, to);
 }
 
 QByteArray AudioProcessor::convertBitDepth(const QByteArray& audioData, int fromBitDepth, int toBitDepth)
 {
-    // Simplified bit depth conversion implementation
-    return audioData; // Placeholder
+    PcmFormat from;
+    from.sampleRate = m_sampleRate;
+    from.channels = m_channels;
+    from.bitDepth = fromBitDepth;
+    
+    PcmFormat to = from;
+    to.bitDepth = toBitDepth;
+    
+    return Resampler::convert(audioData, from, to);
 }
 
 QString AudioProcessor::formatToString(AudioEffectType effect) const
@@ -1051,9 +1187,7 @@ void AudioProcessor::onQualityCheckTimer()
     QMutexLocker locker(&m_mutex);
     for (auto it = m_qualityMonitoringEnabled.begin(); it != m_qualityMonitoringEnabled.end(); ++it) {
         if (it.value()) {
-            QString streamId = it.key();
-            // Perform quality checks
-            // This would typically analyze recent audio data
+            checkLoudnessCompliance(it.key());
         }
     }
 }
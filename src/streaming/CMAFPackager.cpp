@@ -0,0 +1,383 @@
+#include "streaming/CMAFPackager.h"
+
+#include <QVector>
+
+#include <cstring>
+
+namespace LegacyStream {
+
+namespace {
+
+/**
+ * Appends big-endian fields and nested boxes; box sizes are patched when
+ * the box is closed.
+ */
+class BoxWriter
+{
+public:
+    explicit BoxWriter(QByteArray& out) : m_out(out) {}
+
+    void u8(quint32 value) { m_out.append(char(value & 0xFF)); }
+    void u16(quint32 value) { u8(value >> 8); u8(value); }
+    void u24(quint32 value) { u8(value >> 16); u16(value); }
+    void u32(quint32 value) { u16(value >> 16); u16(value); }
+    void u64(quint64 value) { u32(static_cast<quint32>(value >> 32)); u32(static_cast<quint32>(value)); }
+    void zeros(int count) { m_out.append(count, '\0'); }
+    void bytes(const QByteArray& data) { m_out.append(data); }
+    void fourcc(const char* type) { m_out.append(type, 4); }
+
+    void begin(const char* type)
+    {
+        m_open.append(m_out.size());
+        u32(0);
+        fourcc(type);
+    }
+
+    void beginFull(const char* type, int version, quint32 flags)
+    {
+        begin(type);
+        u8(version);
+        u24(flags);
+    }
+
+    void end()
+    {
+        const int start = m_open.takeLast();
+        patch32(start, static_cast<quint32>(m_out.size() - start));
+    }
+
+    int position() const { return m_out.size(); }
+
+    void patch32(int offset, quint32 value)
+    {
+        m_out[offset] = char(value >> 24);
+        m_out[offset + 1] = char(value >> 16);
+        m_out[offset + 2] = char(value >> 8);
+        m_out[offset + 3] = char(value);
+    }
+
+    void matrix()
+    {
+        // Unity matrix, 16.16 and 2.30 fixed point
+        static const quint32 UNITY[9] = {0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+        for (quint32 value : UNITY) {
+            u32(value);
+        }
+    }
+
+private:
+    QByteArray& m_out;
+    QVector<int> m_open;
+};
+
+// MPEG-4 descriptor with a one-byte length; every descriptor here is short
+void descriptor(BoxWriter& box, int tag, const QByteArray& body)
+{
+    box.u8(tag);
+    box.u8(body.size());
+    box.bytes(body);
+}
+
+QByteArray esdsBody(const CMAFTrack& track)
+{
+    const bool mp3 = track.codec == AudioFrameParser::Codec::MP3;
+
+    QByteArray config;
+    BoxWriter decoder(config);
+    decoder.u8(mp3 ? 0x6B : 0x40); // objectTypeIndication
+    decoder.u8(0x15);              // AudioStream, upstream 0, reserved 1
+    decoder.u24(0);                // bufferSizeDB
+    decoder.u32(0);                // maxBitrate
+    decoder.u32(0);                // avgBitrate
+    if (!track.decoderConfig.isEmpty()) {
+        descriptor(decoder, 0x05, track.decoderConfig);
+    }
+
+    QByteArray es;
+    BoxWriter stream(es);
+    stream.u16(CMAFPackager::TRACK_ID);
+    stream.u8(0);
+    descriptor(stream, 0x04, config);
+    descriptor(stream, 0x06, QByteArray(1, char(0x02))); // SLConfig predefined MP4
+    return es;
+}
+
+void sampleEntry(BoxWriter& box, const CMAFTrack& track)
+{
+    const bool opus = track.codec == AudioFrameParser::Codec::OGG_OPUS;
+
+    box.begin(opus ? "Opus" : "mp4a");
+    box.zeros(6);
+    box.u16(1); // data_reference_index
+    box.zeros(8);
+    box.u16(track.channels);
+    box.u16(16);
+    box.zeros(4);
+    box.u32(static_cast<quint32>(track.sampleRate) << 16);
+
+    if (opus) {
+        box.begin("dOps");
+        box.bytes(track.decoderConfig);
+        box.end();
+    } else {
+        QByteArray es;
+        BoxWriter writer(es);
+        descriptor(writer, 0x03, esdsBody(track));
+        box.beginFull("esds", 0, 0);
+        box.bytes(es);
+        box.end();
+    }
+    box.end();
+}
+
+} // namespace
+
+QString CMAFTrack::codecsAttribute() const
+{
+    switch (codec) {
+        case AudioFrameParser::Codec::AAC_ADTS:
+            return QString("mp4a.40.%1").arg(decoderConfig.isEmpty() ? 2 : (uchar(decoderConfig.at(0)) >> 3));
+        case AudioFrameParser::Codec::MP3:
+            return "mp4a.6B";
+        case AudioFrameParser::Codec::OGG_OPUS:
+            return "opus";
+        default:
+            return QString();
+    }
+}
+
+CMAFTrack CMAFTrack::fromAdts(const uchar* header, int sampleRate, int channels)
+{
+    // AudioSpecificConfig: object type, frequency index, channel config
+    const int objectType = (header[2] >> 6) + 1;
+    const int rateIndex = (header[2] >> 2) & 0xF;
+    const int channelConfig = ((header[2] & 1) << 2) | (header[3] >> 6);
+
+    CMAFTrack track;
+    track.codec = AudioFrameParser::Codec::AAC_ADTS;
+    track.sampleRate = sampleRate;
+    track.channels = channels;
+    track.decoderConfig.append(char((objectType << 3) | (rateIndex >> 1)));
+    track.decoderConfig.append(char(((rateIndex & 1) << 7) | (channelConfig << 3)));
+    return track;
+}
+
+CMAFTrack CMAFTrack::fromMp3(int sampleRate, int channels)
+{
+    CMAFTrack track;
+    track.codec = AudioFrameParser::Codec::MP3;
+    track.sampleRate = sampleRate;
+    track.channels = channels;
+    return track;
+}
+
+CMAFTrack CMAFTrack::fromOpusHead(const uchar* p, qint64 length)
+{
+    // RFC 7845 5.1; the little-endian header becomes a big-endian dOps
+    CMAFTrack track;
+    if (length < 19 || memcmp(p, "OpusHead", 8) != 0 || (p[8] & 0xF0) != 0) {
+        return track;
+    }
+
+    const int channels = p[9];
+    const int family = p[18];
+    if (channels == 0 || (family != 0 && length < 21 + channels)) {
+        return track;
+    }
+
+    track.codec = AudioFrameParser::Codec::OGG_OPUS;
+    track.sampleRate = 48000;
+    track.channels = channels;
+    track.preSkip = p[10] | (p[11] << 8);
+
+    BoxWriter dops(track.decoderConfig);
+    dops.u8(0);
+    dops.u8(channels);
+    dops.u16(track.preSkip);
+    dops.u32(p[12] | (p[13] << 8) | (p[14] << 16) | (quint32(p[15]) << 24));
+    dops.u16(p[16] | (p[17] << 8));
+    dops.u8(family);
+    if (family != 0) {
+        // Stream count, coupled count and the mapping table
+        track.decoderConfig.append(reinterpret_cast<const char*>(p + 19), 2 + channels);
+    }
+    return track;
+}
+
+QByteArray CMAFPackager::initSegment(const CMAFTrack& track)
+{
+    QByteArray out;
+    out.reserve(768);
+    BoxWriter box(out);
+
+    box.begin("ftyp");
+    box.fourcc("cmf2");
+    box.u32(0);
+    box.fourcc("cmf2");
+    box.fourcc("cmfc");
+    box.fourcc("iso6");
+    box.fourcc("mp41");
+    box.fourcc("dash");
+    box.end();
+
+    box.begin("moov");
+
+    box.beginFull("mvhd", 0, 0);
+    box.u32(0);          // creation_time
+    box.u32(0);          // modification_time
+    box.u32(1000);       // timescale
+    box.u32(0);          // duration: live
+    box.u32(0x00010000); // rate
+    box.u16(0x0100);     // volume
+    box.zeros(10);
+    box.matrix();
+    box.zeros(24);       // pre_defined
+    box.u32(TRACK_ID + 1);
+    box.end();
+
+    box.begin("trak");
+
+    box.beginFull("tkhd", 0, 0x000003); // enabled, in movie
+    box.u32(0);
+    box.u32(0);
+    box.u32(TRACK_ID);
+    box.u32(0);
+    box.u32(0); // duration
+    box.zeros(8);
+    box.u16(0); // layer
+    box.u16(1); // alternate_group
+    box.u16(0x0100);
+    box.u16(0);
+    box.matrix();
+    box.u32(0); // width
+    box.u32(0); // height
+    box.end();
+
+    if (track.preSkip > 0) {
+        // Trim the encoder priming so playback starts on the first real sample
+        box.begin("edts");
+        box.beginFull("elst", 0, 0);
+        box.u32(1);
+        box.u32(0); // segment_duration: the whole (live) track
+        box.u32(static_cast<quint32>(track.preSkip));
+        box.u16(1);
+        box.u16(0);
+        box.end();
+        box.end();
+    }
+
+    box.begin("mdia");
+
+    box.beginFull("mdhd", 0, 0);
+    box.u32(0);
+    box.u32(0);
+    box.u32(static_cast<quint32>(track.sampleRate));
+    box.u32(0);
+    box.u16(0x55C4); // "und"
+    box.u16(0);
+    box.end();
+
+    box.beginFull("hdlr", 0, 0);
+    box.u32(0);
+    box.fourcc("soun");
+    box.zeros(12);
+    box.bytes(QByteArray("SoundHandler", 13));
+    box.end();
+
+    box.begin("minf");
+
+    box.beginFull("smhd", 0, 0);
+    box.u16(0);
+    box.u16(0);
+    box.end();
+
+    box.begin("dinf");
+    box.beginFull("dref", 0, 0);
+    box.u32(1);
+    box.beginFull("url ", 0, 0x000001); // media is in this file
+    box.end();
+    box.end();
+    box.end();
+
+    box.begin("stbl");
+    box.beginFull("stsd", 0, 0);
+    box.u32(1);
+    sampleEntry(box, track);
+    box.end();
+    // Sample tables stay empty; samples are described by each fragment
+    for (const char* type : {"stts", "stsc", "stco"}) {
+        box.beginFull(type, 0, 0);
+        box.u32(0);
+        box.end();
+    }
+    box.beginFull("stsz", 0, 0);
+    box.u32(0);
+    box.u32(0);
+    box.end();
+    box.end(); // stbl
+
+    box.end(); // minf
+    box.end(); // mdia
+    box.end(); // trak
+
+    box.begin("mvex");
+    box.beginFull("trex", 0, 0);
+    box.u32(TRACK_ID);
+    box.u32(1); // default_sample_description_index
+    box.u32(0);
+    box.u32(0);
+    box.u32(0);
+    box.end();
+    box.end();
+
+    box.end(); // moov
+    return out;
+}
+
+QByteArray CMAFPackager::fragment(quint32 sequenceNumber, quint64 baseMediaDecodeTime,
+                                  const QVector<CMAFSample>& samples, const QByteArray& payload)
+{
+    QByteArray out;
+    out.reserve(128 + samples.size() * 8 + payload.size());
+    BoxWriter box(out);
+
+    box.begin("moof");
+
+    box.beginFull("mfhd", 0, 0);
+    box.u32(sequenceNumber);
+    box.end();
+
+    box.begin("traf");
+
+    box.beginFull("tfhd", 0, 0x020000); // default-base-is-moof
+    box.u32(TRACK_ID);
+    box.end();
+
+    box.beginFull("tfdt", 1, 0);
+    box.u64(baseMediaDecodeTime);
+    box.end();
+
+    // data-offset, sample-duration and sample-size present
+    box.beginFull("trun", 0, 0x000301);
+    box.u32(samples.size());
+    const int dataOffset = box.position();
+    box.u32(0);
+    for (const CMAFSample& sample : samples) {
+        box.u32(sample.duration);
+        box.u32(sample.size);
+    }
+    box.end();
+
+    box.end(); // traf
+    box.end(); // moof
+
+    // Samples start right after the mdat header
+    box.patch32(dataOffset, static_cast<quint32>(out.size() + 8));
+
+    box.begin("mdat");
+    box.bytes(payload);
+    box.end();
+    return out;
+}
+
+} // namespace LegacyStream
@@ -0,0 +1,265 @@
+#include "streaming/FallbackSource.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace LegacyStream {
+
+// FallbackFile
+
+FallbackFile::~FallbackFile()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+}
+
+std::shared_ptr<const FallbackFile> FallbackFile::acquire(const QString& fileName, QString* error)
+{
+    static QMutex mutex;
+    static QHash<QString, std::weak_ptr<const FallbackFile>> files;
+
+    const QFileInfo info(fileName);
+    const QString key = info.canonicalFilePath();
+    if (key.isEmpty()) {
+        if (error) {
+            *error = QString("Fallback file %1 does not exist").arg(fileName);
+        }
+        return nullptr;
+    }
+
+    QMutexLocker locker(&mutex);
+    std::shared_ptr<const FallbackFile> file = files.value(key).lock();
+    if (file && file->m_size == info.size() && file->m_lastModified == info.lastModified()) {
+        return file;
+    }
+
+    // Replaced or first use. Mounts still playing an older copy keep it
+    // alive until they let go.
+    std::shared_ptr<FallbackFile> loaded(new FallbackFile());
+    if (!loaded->load(key, error)) {
+        return nullptr;
+    }
+    files.insert(key, loaded);
+
+    // Drop entries whose last user has gone
+    for (auto it = files.begin(); it != files.end();) {
+        if (it.value().expired()) {
+            it = files.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return loaded;
+}
+
+bool FallbackFile::load(const QString& fileName, QString* error)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = QString("Cannot open fallback file %1: %2").arg(fileName, m_file.errorString());
+        }
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_lastModified = QFileInfo(fileName).lastModified();
+    m_data = m_size > 0 ? m_file.map(0, m_size) : nullptr;
+    if (!m_data) {
+        if (error) {
+            *error = QString("Cannot map fallback file %1").arg(fileName);
+        }
+        return false;
+    }
+
+    buildIndex(AudioFrameParser::codecFromString(QFileInfo(fileName).suffix()));
+    qDebug() << "FallbackFile: Mapped" << fileName << m_size << "bytes," << m_frames.size() << "frames,"
+             << m_duration / 1000 << "ms";
+    return true;
+}
+
+void FallbackFile::buildIndex(AudioFrameParser::Codec codec)
+{
+    if (codec == AudioFrameParser::Codec::UNKNOWN) {
+        return;
+    }
+
+    // Walk header to header once; tags and junk between frames are skipped
+    // so the loop never hands a decoder anything but whole frames
+    qint64 samples = 0;
+    qint64 pos = AudioFrameParser::findFrameStart(codec, m_data, m_size);
+    AudioFrameInfo info;
+
+    while (pos >= 0 && pos < m_size) {
+        const auto result = AudioFrameParser::parse(codec, m_data + pos, m_size - pos, info);
+        if (result == AudioFrameParser::Result::NeedMoreData) {
+            break;
+        }
+        if (result == AudioFrameParser::Result::NoSync ||
+            (m_sampleRate != 0 && info.sampleRate != m_sampleRate)) {
+            pos = AudioFrameParser::findFrameStart(codec, m_data, m_size, pos + 1);
+            continue;
+        }
+        if (pos + info.length > m_size) {
+            break; // truncated last frame
+        }
+
+        if (m_sampleRate == 0) {
+            m_sampleRate = info.sampleRate;
+            m_channels = info.channels;
+        }
+
+        FallbackFrame frame;
+        frame.offset = pos;
+        frame.length = info.length;
+        frame.timestamp = samples * 1000000 / m_sampleRate;
+        m_frames.append(frame);
+
+        samples += info.samples;
+        pos += info.length;
+    }
+
+    m_duration = m_sampleRate > 0 ? samples * 1000000 / m_sampleRate : 0;
+    m_frames.squeeze();
+}
+
+// FallbackSource
+
+FallbackSource::FallbackSource(QObject* parent)
+    : QObject(parent)
+    , m_timer(new QTimer(this))
+{
+    m_timer->setSingleShot(false);
+    m_timer->setInterval(TICK_INTERVAL);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &FallbackSource::onTick);
+}
+
+FallbackSource::~FallbackSource()
+{
+    close();
+}
+
+bool FallbackSource::open(const QString& fileName)
+{
+    close();
+
+    QString errorString;
+    m_file = FallbackFile::acquire(fileName, &errorString);
+    if (!m_file) {
+        emit error(errorString);
+        return false;
+    }
+
+    m_frameIndex = 0;
+    m_position = m_file->loopStart();
+    return true;
+}
+
+void FallbackSource::close()
+{
+    stop();
+    m_file.reset();
+    m_frameIndex = 0;
+    m_loopBase = 0;
+    m_position = 0;
+}
+
+bool FallbackSource::start(int bitrate)
+{
+    if (!m_file) {
+        return false;
+    }
+
+    // Each activation resumes the loop where it left off, on a frame
+    m_byteRate = qMax(1, bitrate) * 1000 / 8;
+    m_bytesSent = 0;
+    m_loopBase = m_file->isIndexed() ? -m_file->frames().at(m_frameIndex).timestamp : 0;
+    m_clock.start();
+    m_timer->start();
+    onTick();
+    return true;
+}
+
+void FallbackSource::stop()
+{
+    m_timer->stop();
+}
+
+void FallbackSource::onTick()
+{
+    if (!m_file) {
+        return;
+    }
+
+    if (m_file->isIndexed()) {
+        sendFrames(m_clock.nsecsElapsed() / 1000);
+    } else {
+        sendBytes(m_clock.elapsed());
+    }
+}
+
+void FallbackSource::sendFrames(qint64 now)
+{
+    const QVector<FallbackFrame>& frames = m_file->frames();
+    const qint64 loopDuration = qMax<qint64>(1, m_file->duration());
+
+    // Release every frame whose start time has passed, coalescing runs of
+    // adjacent frames into a single view
+    qint64 runStart = -1;
+    qint64 runEnd = -1;
+    while (m_loopBase + frames.at(m_frameIndex).timestamp <= now) {
+        const FallbackFrame& frame = frames.at(m_frameIndex);
+        if (frame.offset != runEnd) {
+            if (runStart >= 0) {
+                emitRange(runStart, runEnd - runStart);
+            }
+            runStart = frame.offset;
+        }
+        runEnd = frame.offset + frame.length;
+
+        if (++m_frameIndex == frames.size()) {
+            m_frameIndex = 0;
+            m_loopBase += loopDuration;
+            emitRange(runStart, runEnd - runStart);
+            runStart = runEnd = -1;
+        }
+    }
+
+    if (runStart >= 0) {
+        emitRange(runStart, runEnd - runStart);
+    }
+}
+
+void FallbackSource::sendBytes(qint64 now)
+{
+    const qint64 loopStart = m_file->loopStart();
+    const qint64 size = m_file->size();
+    if (size <= loopStart) {
+        return;
+    }
+
+    qint64 owed = now * m_byteRate / 1000 - m_bytesSent;
+    while (owed > 0) {
+        const qint64 chunk = qMin(owed, size - m_position);
+        emitRange(m_position, chunk);
+        m_bytesSent += chunk;
+        m_position += chunk;
+        owed -= chunk;
+        if (m_position >= size) {
+            m_position = loopStart;
+        }
+    }
+}
+
+void FallbackSource::emitRange(qint64 offset, qint64 length)
+{
+    emit dataReady(QByteArray::fromRawData(reinterpret_cast<const char*>(m_file->data() + offset),
+                                           static_cast<int>(length)));
+}
+
+} // namespace LegacyStream
@@ -0,0 +1,186 @@
+#include "streaming/HLSArchive.h"
+
+#include <QDebug>
+
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+namespace LegacyStream {
+
+HLSArchive::~HLSArchive()
+{
+    close();
+}
+
+bool HLSArchive::open(const QString& fileName, qint64 capacity, QString* error)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        if (error) {
+            *error = QString("Cannot open DVR archive %1: %2").arg(fileName, m_file.errorString());
+        }
+        return false;
+    }
+
+    // Reserve the blocks up front so appends never hit a full disk or
+    // fragment the file; resize alone would leave it sparse
+    bool allocated = false;
+#ifdef Q_OS_LINUX
+    allocated = posix_fallocate(m_file.handle(), 0, capacity) == 0;
+#endif
+    if (!allocated && !m_file.resize(capacity)) {
+        if (error) {
+            *error = QString("Cannot allocate %1 bytes for DVR archive %2").arg(capacity).arg(fileName);
+        }
+        m_file.remove();
+        return false;
+    }
+
+    m_data = m_file.map(0, capacity);
+    if (!m_data) {
+        if (error) {
+            *error = QString("Cannot map DVR archive %1").arg(fileName);
+        }
+        m_file.remove();
+        return false;
+    }
+
+    m_capacity = capacity;
+    m_index.resize(64);
+    clear();
+    qDebug() << "HLSArchive: Opened" << fileName << capacity / (1024 * 1024) << "MB";
+    return true;
+}
+
+void HLSArchive::close()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+    }
+    if (m_file.isOpen()) {
+        m_file.remove();
+    }
+    m_capacity = 0;
+    m_index.clear();
+    m_inits.clear();
+    clear();
+}
+
+void HLSArchive::clear()
+{
+    m_head = 0;
+    m_count = 0;
+    m_seconds = 0.0;
+    m_writePos = 0;
+}
+
+void HLSArchive::setWindow(int seconds)
+{
+    m_window = qMax(0, seconds);
+    expire();
+}
+
+bool HLSArchive::append(const HLSSegment& segment)
+{
+    const qint64 length = segment.data.size();
+    if (!m_data || length == 0 || length > m_capacity) {
+        return false;
+    }
+
+    // Lookups rely on consecutive sequence numbers; start over on a gap
+    if (m_count > 0 && segment.sequence != lastSequence() + 1) {
+        clear();
+    }
+
+    qint64 offset = m_writePos;
+    if (offset + length > m_capacity) {
+        offset = 0;
+    }
+
+    // The byte ring is in index order, so whatever the new segment
+    // overwrites is at the head
+    while (m_count > 0) {
+        const HLSArchiveEntry& oldest = at(0);
+        if (oldest.offset >= offset + length || oldest.offset + oldest.length <= offset) {
+            break;
+        }
+        evictOldest();
+    }
+
+    memcpy(m_data + offset, segment.data.constData(), static_cast<size_t>(length));
+    m_writePos = offset + length;
+
+    if (m_count == m_index.size()) {
+        // Grow the ring, unrolling it so the head is back at zero
+        QVector<HLSArchiveEntry> grown(m_index.size() * 2);
+        for (int i = 0; i < m_count; ++i) {
+            grown[i] = at(i);
+        }
+        m_index.swap(grown);
+        m_head = 0;
+    }
+
+    HLSArchiveEntry& entry = m_index[(m_head + m_count) % m_index.size()];
+    entry.sequence = segment.sequence;
+    entry.offset = offset;
+    entry.length = length;
+    entry.startSample = segment.startSample;
+    entry.samples = segment.samples;
+    entry.sampleRate = segment.sampleRate;
+    entry.initId = segment.initId;
+    entry.discontinuity = segment.discontinuity;
+    entry.programDateTime = segment.programDateTime;
+    ++m_count;
+    m_seconds += entry.duration();
+
+    expire();
+    return true;
+}
+
+void HLSArchive::expire()
+{
+    while (m_count > 1 && m_seconds - at(0).duration() >= m_window) {
+        evictOldest();
+    }
+
+    // Init segments are tiny; keep those the remaining entries refer to
+    const int oldestInit = m_count > 0 ? at(0).initId : -1;
+    while (!m_inits.isEmpty() && oldestInit >= 0 && m_inits.firstKey() < oldestInit) {
+        m_inits.erase(m_inits.begin());
+    }
+}
+
+void HLSArchive::evictOldest()
+{
+    m_seconds -= at(0).duration();
+    m_head = (m_head + 1) % m_index.size();
+    --m_count;
+    if (m_count == 0) {
+        m_seconds = 0.0;
+    }
+}
+
+const HLSArchiveEntry* HLSArchive::entry(qint64 sequence) const
+{
+    if (m_count == 0 || sequence < firstSequence() || sequence > lastSequence()) {
+        return nullptr;
+    }
+    return &at(static_cast<int>(sequence - firstSequence()));
+}
+
+QByteArray HLSArchive::read(qint64 sequence) const
+{
+    const HLSArchiveEntry* found = entry(sequence);
+    if (!found) {
+        return QByteArray();
+    }
+    return QByteArray(reinterpret_cast<const char*>(m_data + found->offset), static_cast<int>(found->length));
+}
+
+} // namespace LegacyStream
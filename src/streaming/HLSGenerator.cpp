@@ -1,12 +1,31 @@
 #include "streaming/HLSGenerator.h"
+#include "streaming/StreamManager.h"
+#include "core/Configuration.h"
+
+#include <QCryptographicHash>
 #include <QDebug>
+#include <QMutexLocker>
+
+#include <atomic>
 
 namespace LegacyStream {
 
+const QString HLSGenerator::SOURCE_QUALITY = "source";
+
 HLSGenerator::HLSGenerator(QObject *parent)
     : QObject(parent)
     , m_isRunning(false)
+    , m_cleanupTimer(new QTimer(this))
+    , m_writer(new HLSWriter(this))
+    , m_playlists(std::make_shared<const PlaylistMap>())
 {
+    m_cleanupTimer->setSingleShot(false);
+    m_cleanupTimer->setInterval(30000);
+    connect(m_cleanupTimer, &QTimer::timeout, this, &HLSGenerator::onCleanupTimer);
+    connect(m_writer, &HLSWriter::writeFailed, this, [this](const QString& path, const QString& reason) {
+        emit error(QString("Cannot write %1: %2").arg(path, reason));
+    });
+
     qDebug() << "HLSGenerator initialized";
 }
 
@@ -25,7 +44,15 @@ bool HLSGenerator::initialize()
 void HLSGenerator::shutdown()
 {
     qDebug() << "HLSGenerator: Shutting down";
-    m_isRunning = false;
+    stop();
+
+    QMutexLocker locker(&m_mutex);
+    m_segmenters.clear();
+    m_archives.clear();
+    m_persisted.clear();
+    m_renditions.clear();
+    m_lastSegmentTime.clear();
+    std::atomic_store(&m_playlists, std::make_shared<const PlaylistMap>());
 }
 
 bool HLSGenerator::isRunning() const
@@ -36,6 +63,11 @@ bool HLSGenerator::isRunning() const
 bool HLSGenerator::start()
 {
     qDebug() << "HLSGenerator: Starting";
+    m_startTime = QDateTime::currentDateTime();
+    m_cleanupTimer->start();
+    if (m_persist && !m_writer->isRunning()) {
+        m_writer->start(m_outputDirectory);
+    }
     m_isRunning = true;
     return true;
 }
@@ -43,29 +75,907 @@ bool HLSGenerator::start()
 void HLSGenerator::stop()
 {
     qDebug() << "HLSGenerator: Stopping";
+    m_cleanupTimer->stop();
+    m_writer->stop(); // flushes whatever is still queued
     m_isRunning = false;
 }
 
 void HLSGenerator::setStreamManager(StreamManager* streamManager)
 {
+    if (m_streamManager) {
+        disconnect(m_streamManager, nullptr, this, nullptr);
+    }
+
     m_streamManager = streamManager;
+    if (m_streamManager) {
+        connect(m_streamManager, &StreamManager::streamDataReceived, this, &HLSGenerator::onStreamDataReceived);
+        connect(m_streamManager, &StreamManager::streamRemoved, this, &HLSGenerator::removeMountPoint);
+    }
+}
+
+void HLSGenerator::setOutputDirectory(const QString& directory)
+{
+    m_outputDirectory = directory;
+    if (m_writer->isRunning()) {
+        m_writer->start(m_outputDirectory);
+    }
+}
+
+void HLSGenerator::setSegmentDuration(int seconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_segmentDuration = qMax(1, seconds);
+    for (const auto& segmenter : m_segmenters) {
+        segmenter->setSegmentDuration(m_segmentDuration);
+    }
+}
+
+void HLSGenerator::setPlaylistLength(int segments)
+{
+    QMutexLocker locker(&m_mutex);
+    m_playlistLength = qMax(1, segments);
+    for (const auto& segmenter : m_segmenters) {
+        segmenter->setCapacity(m_playlistLength + EXTRA_SEGMENTS);
+    }
+}
+
+void HLSGenerator::setPartDuration(int milliseconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_partDuration = qMax(0, milliseconds);
+    for (const auto& segmenter : m_segmenters) {
+        segmenter->setPartDuration(m_partDuration);
+    }
+}
+
+void HLSGenerator::setContainer(HLSSegmenter::Container container)
+{
+    QMutexLocker locker(&m_mutex);
+    m_container = container;
+    for (const auto& segmenter : m_segmenters) {
+        segmenter->setContainer(m_container);
+    }
+}
+
+void HLSGenerator::setDvrWindow(const QString& mountPoint, int seconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_dvrWindows.insert(mountPoint, qMax(0, seconds));
+    for (const QString& quality : m_renditions.value(mountPoint)) {
+        const QString key = renditionKey(mountPoint, quality);
+        if (seconds <= 0) {
+            m_archives.remove(key);
+        } else if (const auto archive = m_archives.value(key)) {
+            archive->setWindow(seconds);
+        }
+    }
+}
+
+void HLSGenerator::setPersistSegments(bool enabled)
+{
+    m_persist = enabled;
+    if (!enabled) {
+        m_writer->stop();
+    } else if (isRunning() && !m_writer->isRunning()) {
+        m_writer->start(m_outputDirectory);
+    }
+}
+
+void HLSGenerator::setQualityLevels(const QStringList& levels)
+{
+    QMutexLocker locker(&m_mutex);
+    m_qualityLevels = levels;
+}
+
+void HLSGenerator::setTargetBitrates(const QList<int>& bitrates)
+{
+    QMutexLocker locker(&m_mutex);
+    m_targetBitrates = bitrates;
+}
+
+QString HLSGenerator::getMasterPlaylistUrl() const
+{
+    return "/hls/<mount>/master.m3u8";
+}
+
+QString HLSGenerator::getVariantPlaylistUrl(const QString& quality) const
+{
+    return QString("/hls/<mount>/%1/index.m3u8").arg(quality);
+}
+
+QJsonObject HLSGenerator::getStatusJson() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QJsonArray renditions;
+    for (auto it = m_segmenters.constBegin(); it != m_segmenters.constEnd(); ++it) {
+        const HLSSegmenter& segmenter = *it.value();
+        qint64 bytes = 0;
+        for (const HLSSegment& segment : segmenter.segments()) {
+            bytes += segment.data.size();
+        }
+
+        QJsonObject rendition;
+        rendition["id"] = it.key();
+        rendition["segments"] = segmenter.segments().size();
+        rendition["firstSequence"] = segmenter.firstSequence();
+        rendition["lastSequence"] = segmenter.lastSequence();
+        rendition["bytes"] = bytes;
+        rendition["bitrate"] = segmenter.averageBitrate();
+        rendition["peakBitrate"] = segmenter.peakBitrate();
+        rendition["position"] = segmenter.position();
+        const int step = m_qualityLevels.indexOf(it.key().section('|', 1));
+        if (step >= 0 && step < m_targetBitrates.size()) {
+            rendition["targetBitrate"] = m_targetBitrates.at(step) * 1000;
+        }
+        renditions.append(rendition);
+    }
+
+    QJsonObject status;
+    status["running"] = isRunning();
+    status["segmentDuration"] = m_segmentDuration;
+    status["playlistLength"] = m_playlistLength;
+    status["totalSegmentsGenerated"] = m_totalSegmentsGenerated;
+    status["totalPlaylistsUpdated"] = m_totalPlaylistsUpdated;
+    status["renditions"] = renditions;
+    if (m_writer->isRunning()) {
+        status["writer"] = m_writer->statistics();
+    }
+    return status;
+}
+
+void HLSGenerator::generateSegment(const QString& mountPoint, const QByteArray& audioData)
+{
+    pushRendition(mountPoint, SOURCE_QUALITY, audioData);
+}
+
+void HLSGenerator::generateRendition(const QString& mountPoint, const QString& quality, const QByteArray& encodedData)
+{
+    pushRendition(mountPoint, quality, encodedData);
+}
+
+void HLSGenerator::updatePlaylist(const QString& mountPoint)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        publishPlaylists(mountPoint);
+    }
+    emit playlistUpdated(mountPoint, masterPath(mountPoint));
+}
+
+void HLSGenerator::cleanupOldSegments()
+{
+    // Segments age out of each ring on their own; this drops renditions
+    // whose feed has gone quiet for longer than a full playlist window.
+    // DVR archives only advance their index head past expired entries.
+    const QDateTime now = QDateTime::currentDateTime();
+    const int idleSeconds = m_segmentDuration * (m_playlistLength + EXTRA_SEGMENTS);
+
+    QMutexLocker locker(&m_mutex);
+    for (const auto& archive : m_archives) {
+        archive->expire();
+    }
+
+    QStringList affected;
+    for (auto it = m_lastSegmentTime.begin(); it != m_lastSegmentTime.end();) {
+        if (it.value().secsTo(now) <= idleSeconds) {
+            ++it;
+            continue;
+        }
+
+        const QString key = it.key();
+        const QString mountPoint = key.section('|', 0, 0);
+        m_segmenters.remove(key);
+        m_archives.remove(key);
+        unpersistRendition(key);
+        m_renditions[mountPoint].removeAll(key.section('|', 1));
+        if (m_renditions[mountPoint].isEmpty()) {
+            m_renditions.remove(mountPoint);
+        }
+        if (!affected.contains(mountPoint)) {
+            affected << mountPoint;
+        }
+        it = m_lastSegmentTime.erase(it);
+    }
+
+    for (const QString& mountPoint : affected) {
+        publishPlaylists(mountPoint);
+    }
+}
+
+QVector<UpgradeHandoff::Cursor> HLSGenerator::timelineCursors() const
+{
+    QMutexLocker locker(&m_mutex);
+    QVector<UpgradeHandoff::Cursor> cursors;
+    for (auto it = m_renditions.constBegin(); it != m_renditions.constEnd(); ++it) {
+        // Renditions share the grid, so the first live one speaks for all
+        for (const QString& quality : it.value()) {
+            const auto segmenter = m_segmenters.value(renditionKey(it.key(), quality));
+            if (segmenter && segmenter->sampleRate() > 0) {
+                UpgradeHandoff::Cursor cursor;
+                cursor.mountPoint = it.key();
+                cursor.nextSequence = segmenter->lastSequence() + 1;
+                cursor.position = segmenter->position();
+                cursors.append(cursor);
+                break;
+            }
+        }
+    }
+    return cursors;
+}
+
+void HLSGenerator::resumeTimeline(const UpgradeHandoff::Cursor& cursor)
+{
+    QMutexLocker locker(&m_mutex);
+    m_resumeTimelines.insert(cursor.mountPoint, cursor);
+}
+
+void HLSGenerator::removeMountPoint(const QString& mountPoint)
+{
+    QMutexLocker locker(&m_mutex);
+    m_resumeTimelines.remove(mountPoint);
+    for (const QString& quality : m_renditions.take(mountPoint)) {
+        m_segmenters.remove(renditionKey(mountPoint, quality));
+        m_archives.remove(renditionKey(mountPoint, quality));
+        unpersistRendition(renditionKey(mountPoint, quality));
+        m_lastSegmentTime.remove(renditionKey(mountPoint, quality));
+    }
+    publishPlaylists(mountPoint);
+}
+
+void HLSGenerator::pushRendition(const QString& mountPoint, const QString& quality, const QByteArray& data)
+{
+    const QString key = renditionKey(mountPoint, quality);
+    int completed = 0;
+    int parts = 0;
+    qint64 sequence = 0;
+    QString extension;
+    {
+        QMutexLocker locker(&m_mutex);
+        std::shared_ptr<HLSSegmenter>& segmenter = m_segmenters[key];
+        if (!segmenter) {
+            segmenter = std::make_shared<HLSSegmenter>(m_segmentDuration, m_playlistLength + EXTRA_SEGMENTS);
+            segmenter->setPartDuration(m_partDuration);
+            segmenter->setContainer(m_container);
+            alignRendition(mountPoint, *segmenter);
+            m_renditions[mountPoint].append(quality);
+        }
+
+        completed = segmenter->push(data, &parts);
+        if (completed > 0) {
+            archiveSegments(mountPoint, key, *segmenter, completed);
+            persistSegments(mountPoint, quality, *segmenter, completed);
+        }
+        sequence = segmenter->lastSequence();
+        extension = segmenter->fileExtension();
+        m_lastSegmentTime[key] = QDateTime::currentDateTime();
+        m_totalSegmentsGenerated += completed;
+
+        // Playlists only change when a segment or part lands, so render
+        // them here rather than per request
+        if (completed > 0 || parts > 0) {
+            publishPlaylists(mountPoint);
+        }
+    }
+
+    if (completed > 0 || parts > 0) {
+        // Wakes blocking playlist reloads parked in HttpServer
+        emit mediaPlaylistPublished(mediaPath(mountPoint, quality));
+    }
+    if (completed > 0) {
+        emit segmentGenerated(mountPoint, QString("/hls%1/%2/%3.%4").arg(mountPoint, quality).arg(sequence).arg(extension));
+        emit playlistUpdated(mountPoint, masterPath(mountPoint));
+    }
+}
+
+void HLSGenerator::archiveSegments(const QString& mountPoint, const QString& key,
+                                   const HLSSegmenter& segmenter, int completed)
+{
+    // Called with m_mutex held. Segments are written through as they
+    // complete, so the archive always reaches up to the live edge.
+    const int window = m_dvrWindows.value(mountPoint, Configuration::instance().getMountPointDvrWindow(mountPoint));
+    if (window <= 0) {
+        return;
+    }
+
+    std::shared_ptr<HLSArchive>& archive = m_archives[key];
+    if (!archive) {
+        // Size the file from the first segment's rate with headroom for
+        // VBR; a faster stream just gets a somewhat shorter window
+        const HLSSegment& sample = segmenter.segments().last();
+        const double bytesPerSecond = sample.duration() > 0.0 ? sample.data.size() / sample.duration() : 40000.0;
+        const qint64 capacity = static_cast<qint64>(bytesPerSecond * window * 1.25) + 1024 * 1024;
+
+        QDir().mkpath(m_outputDirectory);
+        QString fileName = key;
+        fileName.replace('/', '_').replace('|', '-');
+        archive = std::make_shared<HLSArchive>();
+        QString errorString;
+        if (!archive->open(QDir(m_outputDirectory).filePath(fileName + ".dvr"), capacity, &errorString)) {
+            qWarning() << "HLSGenerator:" << errorString;
+            m_dvrWindows.insert(mountPoint, 0); // do not retry on every segment
+            m_archives.remove(key);
+            return;
+        }
+        archive->setWindow(window);
+    }
+
+    const QVector<HLSSegment>& segments = segmenter.segments();
+    for (int i = qMax(0, segments.size() - completed); i < segments.size(); ++i) {
+        const HLSSegment& segment = segments.at(i);
+        if (segment.initId >= 0 && archive->initSegment(segment.initId).isEmpty()) {
+            archive->addInitSegment(segment.initId, segmenter.initSegment(segment.initId));
+        }
+        archive->append(segment);
+    }
+}
+
+void HLSGenerator::persistSegments(const QString& mountPoint, const QString& quality,
+                                   const HLSSegmenter& segmenter, int completed)
+{
+    // Called with m_mutex held. Only queues: the writer's threads do the
+    // I/O, so a stalled disk cannot hold up the event loop or this lock.
+    if (!m_writer->isRunning()) {
+        return;
+    }
+
+    const QString key = renditionKey(mountPoint, quality);
+    const QString directory = QString("hls%1/%2/").arg(mountPoint, quality);
+    QList<QPair<qint64, QString>>& files = m_persisted[key];
+
+    const QVector<HLSSegment>& segments = segmenter.segments();
+    for (int i = qMax(0, segments.size() - completed); i < segments.size(); ++i) {
+        const HLSSegment& segment = segments.at(i);
+        if (segment.initId >= 0) {
+            // Init segments live as long as the rendition (sequence -1)
+            const QString init = directory + QString("init-%1.mp4").arg(segment.initId);
+            if (!files.contains(qMakePair(qint64(-1), init))) {
+                m_writer->write(init, segmenter.initSegment(segment.initId));
+                files.append(qMakePair(qint64(-1), init));
+            }
+        }
+        const QString file = directory + QString("%1.%2").arg(segment.sequence).arg(segmenter.fileExtension());
+        m_writer->write(file, segment.data);
+        files.append(qMakePair(segment.sequence, file));
+    }
+
+    // Follow the ring: files for segments it no longer holds go
+    const qint64 first = segmenter.firstSequence();
+    for (auto it = files.begin(); it != files.end();) {
+        if (it->first >= 0 && it->first < first) {
+            m_writer->remove(it->second);
+            it = files.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void HLSGenerator::unpersistRendition(const QString& key)
+{
+    // Called with m_mutex held
+    for (const auto& file : m_persisted.take(key)) {
+        m_writer->remove(file.second);
+    }
+}
+
+void HLSGenerator::alignRendition(const QString& mountPoint, HLSSegmenter& segmenter) const
+{
+    // Called with m_mutex held. A ladder step joining a mount that is
+    // already live starts on the leader's timeline, in the leader's open
+    // segment, so every rendition cuts on the same grid lines and shares
+    // media sequence numbers; ABR switches then land on matching segments.
+    for (const QString& quality : m_renditions.value(mountPoint)) {
+        const auto leader = m_segmenters.value(renditionKey(mountPoint, quality));
+        if (leader && leader->sampleRate() > 0) {
+            segmenter.alignTo(leader->lastSequence() + 1, leader->position());
+            return;
+        }
+    }
+
+    // The first rendition after a binary upgrade continues the old
+    // process's timeline
+    const auto resumed = m_resumeTimelines.constFind(mountPoint);
+    if (resumed != m_resumeTimelines.constEnd()) {
+        segmenter.alignTo(resumed->nextSequence, resumed->position, true);
+    }
+}
+
+void HLSGenerator::publishPlaylists(const QString& mountPoint)
+{
+    // Called with m_mutex held, which serialises writers. Readers take a
+    // snapshot with atomic_load and never see a half-built map.
+    const std::shared_ptr<const PlaylistMap> current = std::atomic_load(&m_playlists);
+    auto next = std::make_shared<PlaylistMap>(*current);
+
+    const QString prefix = "/hls" + mountPoint + "/";
+    const QString manifest = dashPath(mountPoint);
+    for (auto it = next->begin(); it != next->end();) {
+        if (it.key().startsWith(prefix) || it.key() == manifest) {
+            it = next->erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    int targetDuration = m_segmentDuration;
+    for (const QString& quality : m_renditions.value(mountPoint)) {
+        const auto segmenter = m_segmenters.value(renditionKey(mountPoint, quality));
+        if (!segmenter || segmenter->segments().isEmpty()) {
+            continue;
+        }
+
+        // Clients re-poll a live media playlist about every half target duration
+        const QString path = mediaPath(mountPoint, quality);
+        targetDuration = segmenter->targetDuration();
+        const auto archive = m_archives.value(renditionKey(mountPoint, quality));
+        next->insert(path, makePlaylist(renderMediaPlaylist(*segmenter, archive.get()), qMax(1, targetDuration / 2),
+                                        current->value(path), segmenter.get()));
+    }
+
+    const QByteArray master = renderMasterPlaylist(mountPoint);
+    if (!master.isEmpty()) {
+        const QString path = masterPath(mountPoint);
+        next->insert(path, makePlaylist(master, targetDuration, current->value(path)));
+    }
+
+    // DASH reads the same CMAF segments, so only the manifest is extra
+    const QByteArray mpd = renderDashManifest(mountPoint);
+    if (!mpd.isEmpty()) {
+        next->insert(manifest, makePlaylist(mpd, qMax(1, targetDuration / 2), current->value(manifest),
+                                            nullptr, "application/dash+xml"));
+    }
+
+    if (m_writer->isRunning()) {
+        // makePlaylist hands back the previous object for unchanged
+        // content, so only playlists that really changed are rewritten
+        for (auto it = next->constBegin(); it != next->constEnd(); ++it) {
+            if (it.value() != current->value(it.key())) {
+                m_writer->write(it.key().mid(1), it.value()->body);
+            }
+        }
+        for (auto it = current->constBegin(); it != current->constEnd(); ++it) {
+            if (!next->contains(it.key())) {
+                m_writer->remove(it.key().mid(1));
+            }
+        }
+    }
+
+    std::atomic_store(&m_playlists, std::shared_ptr<const PlaylistMap>(std::move(next)));
+    ++m_totalPlaylistsUpdated;
+}
+
+std::shared_ptr<const RenderedPlaylist> HLSGenerator::makePlaylist(const QByteArray& body, int maxAge,
+                                                                   const std::shared_ptr<const RenderedPlaylist>& previous,
+                                                                   const HLSSegmenter* segmenter,
+                                                                   const QByteArray& contentType)
+{
+    // Unchanged content keeps its ETag, so revalidations stay 304s
+    if (previous && previous->body == body) {
+        return previous;
+    }
+
+    auto playlist = std::make_shared<RenderedPlaylist>();
+    playlist->body = body;
+    if (segmenter) {
+        playlist->lastSequence = segmenter->lastSequence();
+        playlist->pendingParts = segmenter->pendingParts().size();
+        playlist->targetDuration = segmenter->targetDuration();
+    }
+    playlist->etag = '"' + QCryptographicHash::hash(body, QCryptographicHash::Sha1).toHex().left(16) + '"';
+
+    const QByteArray common = "Content-Type: " + contentType + "\r\n"
+                              "Cache-Control: public, max-age=" + QByteArray::number(maxAge) + "\r\n"
+                              "ETag: " + playlist->etag + "\r\n"
+                              "Access-Control-Allow-Origin: *\r\n"
+                              "Server: LegacyStream\r\n";
+
+    playlist->response = "HTTP/1.1 200 OK\r\n" + common +
+                         "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n";
+    playlist->headerLength = playlist->response.size();
+    playlist->response += body;
+    playlist->notModified = "HTTP/1.1 304 Not Modified\r\n" + common + "\r\n";
+    return playlist;
+}
+
+bool HLSGenerator::handleRequest(const QString& path, QByteArray& body, QString& contentType) const
+{
+    if (path.startsWith("/dash/") && path.endsWith(".mpd")) {
+        const auto manifest = getPlaylist(path);
+        if (!manifest) {
+            return false;
+        }
+        body = manifest->body;
+        contentType = "application/dash+xml";
+        return true;
+    }
+    if (!path.startsWith("/hls/")) {
+        return false;
+    }
+
+    QStringList parts = path.mid(4).split('/', Qt::SkipEmptyParts);
+    if (parts.size() < 2) {
+        return false;
+    }
+
+    const QString file = parts.takeLast();
+    if (file.endsWith(".m3u8")) {
+        const auto playlist = getPlaylist(path);
+        if (!playlist) {
+            return false;
+        }
+        body = playlist->body;
+        contentType = "application/vnd.apple.mpegurl";
+        return true;
+    }
+
+    if (parts.size() < 2) {
+        return false;
+    }
+    const QString quality = parts.takeLast();
+    const QString mountPoint = "/" + parts.join('/');
+
+    bool ok = false;
+    if (file.startsWith("init-") && file.endsWith(".mp4")) {
+        const int id = file.mid(5, file.size() - 9).toInt(&ok);
+        return ok && getInitSegment(mountPoint, quality, id, body, contentType);
+    }
+
+    const qint64 sequence = file.section('.', 0, 0).toLongLong(&ok);
+    if (!ok) {
+        return false;
+    }
+
+    // <seq>.<part>.<ext> names an LL-HLS part
+    if (file.count('.') == 2) {
+        const int index = file.section('.', 1, 1).toInt(&ok);
+        return ok && getPart(mountPoint, quality, sequence, index, body, contentType);
+    }
+    return getSegment(mountPoint, quality, sequence, body, contentType);
+}
+
+std::shared_ptr<const RenderedPlaylist> HLSGenerator::getPlaylist(const QString& path) const
+{
+    return std::atomic_load(&m_playlists)->value(path);
+}
+
+QByteArray HLSGenerator::getMasterPlaylist(const QString& mountPoint) const
+{
+    const auto playlist = getPlaylist(masterPath(mountPoint));
+    return playlist ? playlist->body : QByteArray();
+}
+
+QByteArray HLSGenerator::getMediaPlaylist(const QString& mountPoint, const QString& quality) const
+{
+    const auto playlist = getPlaylist(mediaPath(mountPoint, quality));
+    return playlist ? playlist->body : QByteArray();
+}
+
+bool HLSGenerator::getSegment(const QString& mountPoint, const QString& quality, qint64 sequence,
+                              QByteArray& data, QString& contentType) const
+{
+    QMutexLocker locker(&m_mutex);
+    const auto segmenter = m_segmenters.value(renditionKey(mountPoint, quality));
+    const HLSSegment* segment = segmenter ? segmenter->segment(sequence) : nullptr;
+    if (!segment) {
+        // Older than the memory ring: try the DVR archive
+        const auto archive = m_archives.value(renditionKey(mountPoint, quality));
+        data = archive ? archive->read(sequence) : QByteArray();
+        if (data.isEmpty()) {
+            return false;
+        }
+        contentType = segmenter->contentType();
+        return true;
+    }
+
+    // Implicitly shared: the caller gets the ring's bytes, not a copy
+    data = segment->data;
+    contentType = segmenter->contentType();
+    return true;
+}
+
+bool HLSGenerator::getPart(const QString& mountPoint, const QString& quality, qint64 sequence, int index,
+                           QByteArray& data, QString& contentType) const
+{
+    QMutexLocker locker(&m_mutex);
+    const auto segmenter = m_segmenters.value(renditionKey(mountPoint, quality));
+    const HLSPart* part = segmenter ? segmenter->part(sequence, index) : nullptr;
+    if (!part) {
+        return false;
+    }
+
+    data = part->data;
+    contentType = segmenter->contentType();
+    return true;
+}
+
+bool HLSGenerator::getInitSegment(const QString& mountPoint, const QString& quality, int id,
+                                  QByteArray& data, QString& contentType) const
+{
+    QMutexLocker locker(&m_mutex);
+    const auto segmenter = m_segmenters.value(renditionKey(mountPoint, quality));
+    if (!segmenter) {
+        return false;
+    }
+
+    data = segmenter->initSegment(id);
+    if (data.isEmpty()) {
+        const auto archive = m_archives.value(renditionKey(mountPoint, quality));
+        data = archive ? archive->initSegment(id) : QByteArray();
+    }
+    contentType = "audio/mp4";
+    return !data.isEmpty();
+}
+
+QByteArray HLSGenerator::renderMasterPlaylist(const QString& mountPoint) const
+{
+    const QStringList renditions = m_renditions.value(mountPoint);
+    if (renditions.isEmpty()) {
+        return QByteArray();
+    }
+
+    // Ladder steps in their configured order, then anything else (the
+    // mount's own feed) in the order it appeared
+    QStringList qualities;
+    for (const QString& quality : m_qualityLevels) {
+        if (renditions.contains(quality)) {
+            qualities << quality;
+        }
+    }
+    for (const QString& quality : renditions) {
+        if (!qualities.contains(quality)) {
+            qualities << quality;
+        }
+    }
+
+    // Every audio frame decodes on its own, so every segment start is a
+    // switch point
+    QByteArray playlist = "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-INDEPENDENT-SEGMENTS\n";
+    for (const QString& quality : qualities) {
+        const auto segmenter = m_segmenters.value(renditionKey(mountPoint, quality));
+        if (!segmenter || segmenter->peakBitrate() <= 0) {
+            continue;
+        }
+
+        // Both values are measured from the segments actually produced
+        playlist += QString("#EXT-X-STREAM-INF:BANDWIDTH=%1,AVERAGE-BANDWIDTH=%2,CODECS=\"%3\"\n%4/index.m3u8\n")
+                        .arg(segmenter->peakBitrate())
+                        .arg(segmenter->averageBitrate())
+                        .arg(segmenter->codecsAttribute(), quality)
+                        .toUtf8();
+    }
+    return playlist;
+}
+
+QByteArray HLSGenerator::renderMediaPlaylist(const HLSSegmenter& segmenter, const HLSArchive* archive) const
+{
+    const QVector<HLSSegment>& segments = segmenter.segments();
+    // With a DVR window every held segment is listed, behind the archived ones
+    const bool dvr = archive && !archive->isEmpty() && archive->firstSequence() < segments.first().sequence;
+    const int first = dvr ? 0 : qMax(0, segments.size() - m_playlistLength);
+    int archived = 0;
+    if (dvr) {
+        while (archived < archive->size() && archive->at(archived).sequence < segments.first().sequence) {
+            ++archived;
+        }
+    }
+    const bool lowLatency = segmenter.partDuration() > 0;
+    const QString extension = segmenter.fileExtension();
+    const int version = segmenter.isFragmented() ? 7 : (lowLatency ? 6 : 3);
+
+    QByteArray playlist;
+    playlist.reserve(512 + archived * 64 + (segments.size() - first) * (lowLatency ? 1024 : 96));
+    playlist += QString("#EXTM3U\n#EXT-X-VERSION:%1\n").arg(version).toUtf8();
+    playlist += QString("#EXT-X-TARGETDURATION:%1\n").arg(segmenter.targetDuration()).toUtf8();
+    if (lowLatency) {
+        // Players hold back three parts from the live edge
+        playlist += QString("#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%1\n")
+                        .arg(segmenter.partTarget() * 3, 0, 'f', 3).toUtf8();
+        playlist += QString("#EXT-X-PART-INF:PART-TARGET=%1\n").arg(segmenter.partTarget(), 0, 'f', 3).toUtf8();
+    }
+    playlist += QString("#EXT-X-MEDIA-SEQUENCE:%1\n")
+                    .arg(archived > 0 ? archive->at(0).sequence : segments.at(first).sequence)
+                    .toUtf8();
+
+    auto appendParts = [&](qint64 sequence, const QVector<HLSPart>& parts) {
+        for (const HLSPart& part : parts) {
+            // Every audio frame decodes on its own, so every part is independent
+            playlist += QString("#EXT-X-PART:DURATION=%1,URI=\"%2.%3.%4\",INDEPENDENT=YES\n")
+                            .arg(part.duration(), 0, 'f', 3)
+                            .arg(sequence)
+                            .arg(part.index)
+                            .arg(extension)
+                            .toUtf8();
+        }
+    };
+
+    // CMAF segments need their init segment declared before them
+    int mappedInit = -1;
+    auto appendMap = [&](int initId) {
+        if (initId >= 0 && initId != mappedInit) {
+            playlist += QString("#EXT-X-MAP:URI=\"init-%1.mp4\"\n").arg(initId).toUtf8();
+            mappedInit = initId;
+        }
+    };
+
+    for (int i = 0; i < archived; ++i) {
+        const HLSArchiveEntry& entry = archive->at(i);
+        if (entry.discontinuity) {
+            playlist += "#EXT-X-DISCONTINUITY\n";
+        }
+        appendMap(entry.initId);
+        if (i == 0) {
+            // Lets players label the rewind range with wall-clock times
+            playlist += "#EXT-X-PROGRAM-DATE-TIME:" +
+                        entry.programDateTime.toUTC().toString(Qt::ISODateWithMs).toUtf8() + "\n";
+        }
+        playlist += QString("#EXTINF:%1,\n%2.%3\n")
+                        .arg(entry.duration(), 0, 'f', 3)
+                        .arg(entry.sequence)
+                        .arg(extension)
+                        .toUtf8();
+    }
+
+    for (int i = first; i < segments.size(); ++i) {
+        const HLSSegment& segment = segments.at(i);
+        if (segment.discontinuity) {
+            playlist += "#EXT-X-DISCONTINUITY\n";
+        }
+        appendMap(segment.initId);
+        if (lowLatency) {
+            appendParts(segment.sequence, segment.parts);
+        }
+        playlist += QString("#EXTINF:%1,\n%2.%3\n")
+                        .arg(segment.duration(), 0, 'f', 3)
+                        .arg(segment.sequence)
+                        .arg(extension)
+                        .toUtf8();
+    }
+
+    if (lowLatency) {
+        const qint64 pending = segmenter.lastSequence() + 1;
+        if (segmenter.isFragmented() && !segmenter.pendingParts().isEmpty()) {
+            appendMap(segmenter.initId());
+        }
+        appendParts(pending, segmenter.pendingParts());
+        playlist += QString("#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%1.%2.%3\"\n")
+                        .arg(pending)
+                        .arg(segmenter.pendingParts().size())
+                        .arg(extension)
+                        .toUtf8();
+    }
+    return playlist;
+}
+
+QByteArray HLSGenerator::renderDashManifest(const QString& mountPoint) const
+{
+    // One Representation per rendition, addressing the HLS copies of the
+    // segments through BaseURL. Only the segments behind the newest init
+    // segment are listed; an older setup would need a Period of its own.
+    QByteArray representations;
+    QDateTime availabilityStart;
+    QDateTime publishTime;
+    int targetDuration = m_segmentDuration;
+    double windowSeconds = 0.0;
+
+    for (const QString& quality : m_renditions.value(mountPoint)) {
+        const auto segmenter = m_segmenters.value(renditionKey(mountPoint, quality));
+        if (!segmenter || segmenter->segments().isEmpty()) {
+            continue;
+        }
+        if (!segmenter->isFragmented() || !segmenter->track().isValid()) {
+            return QByteArray();
+        }
+
+        const QVector<HLSSegment>& segments = segmenter->segments();
+        int first = qMax(0, segments.size() - m_playlistLength);
+        while (first < segments.size() && segments.at(first).initId != segmenter->initId()) {
+            ++first;
+        }
+        if (first == segments.size()) {
+            continue;
+        }
+
+        const HLSSegment& start = segments.at(first);
+        if (!availabilityStart.isValid()) {
+            // Wall-clock time of media time zero on this rendition's timeline
+            availabilityStart = start.programDateTime.addMSecs(-start.startSample * 1000 / start.sampleRate);
+        }
+        targetDuration = qMax(targetDuration, segmenter->targetDuration());
+
+        QByteArray timeline;
+        double seconds = 0.0;
+        for (int i = first; i < segments.size(); ++i) {
+            const HLSSegment& segment = segments.at(i);
+            timeline += QString("          <S t=\"%1\" d=\"%2\"/>\n").arg(segment.startSample).arg(segment.samples).toUtf8();
+            seconds += segment.duration();
+        }
+        windowSeconds = qMax(windowSeconds, seconds);
+
+        // Derived from the content, so an unchanged manifest keeps its ETag
+        const HLSSegment& newest = segments.last();
+        const QDateTime end = newest.programDateTime.addMSecs(newest.samples * 1000 / newest.sampleRate);
+        if (!publishTime.isValid() || end > publishTime) {
+            publishTime = end;
+        }
+
+        const CMAFTrack& track = segmenter->track();
+        representations += QString("      <Representation id=\"%1\" codecs=\"%2\" bandwidth=\"%3\" audioSamplingRate=\"%4\">\n"
+                                   "        <AudioChannelConfiguration schemeIdUri=\"urn:mpeg:dash:23003:3:audio_channel_configuration:2011\" value=\"%5\"/>\n"
+                                   "        <BaseURL>/hls%6/%1/</BaseURL>\n"
+                                   "        <SegmentTemplate timescale=\"%4\" initialization=\"init-%7.mp4\" media=\"$Number$.m4s\" startNumber=\"%8\">\n"
+                                   "          <SegmentTimeline>\n")
+                               .arg(quality, track.codecsAttribute())
+                               .arg(qMax<qint64>(1, segmenter->peakBitrate()))
+                               .arg(track.sampleRate)
+                               .arg(track.channels)
+                               .arg(mountPoint)
+                               .arg(segmenter->initId())
+                               .arg(segments.at(first).sequence)
+                               .toUtf8();
+        representations += timeline;
+        representations += "          </SegmentTimeline>\n"
+                           "        </SegmentTemplate>\n"
+                           "      </Representation>\n";
+    }
+
+    if (representations.isEmpty()) {
+        return QByteArray();
+    }
+
+    auto isoDuration = [](double seconds) { return QString("PT%1S").arg(seconds, 0, 'f', 3); };
+    QByteArray mpd = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    mpd += QString("<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" "
+                   "profiles=\"urn:mpeg:dash:profile:isoff-live:2011,urn:mpeg:dash:profile:cmaf:2019\" "
+                   "type=\"dynamic\" availabilityStartTime=\"%1\" publishTime=\"%2\" "
+                   "minimumUpdatePeriod=\"%3\" minBufferTime=\"%3\" timeShiftBufferDepth=\"%4\" "
+                   "suggestedPresentationDelay=\"%5\">\n")
+               .arg(availabilityStart.toUTC().toString(Qt::ISODateWithMs),
+                    publishTime.toUTC().toString(Qt::ISODateWithMs),
+                    isoDuration(targetDuration),
+                    isoDuration(windowSeconds),
+                    isoDuration(targetDuration * 3))
+               .toUtf8();
+    mpd += "  <Period id=\"0\" start=\"PT0S\">\n"
+           "    <AdaptationSet contentType=\"audio\" mimeType=\"audio/mp4\" segmentAlignment=\"true\" lang=\"und\">\n";
+    mpd += representations;
+    mpd += "    </AdaptationSet>\n"
+           "  </Period>\n"
+           "</MPD>\n";
+    return mpd;
+}
+
+QString HLSGenerator::renditionKey(const QString& mountPoint, const QString& quality) const
+{
+    return mountPoint + '|' + quality;
+}
+
+QString HLSGenerator::masterPath(const QString& mountPoint) const
+{
+    return "/hls" + mountPoint + "/master.m3u8";
+}
+
+QString HLSGenerator::mediaPath(const QString& mountPoint, const QString& quality) const
+{
+    return "/hls" + mountPoint + "/" + quality + "/index.m3u8";
 }
 
-void HLSGenerator::onSegmentTimer()
+QString HLSGenerator::dashPath(const QString& mountPoint) const
 {
-    // Stub implementation
+    return "/dash" + mountPoint + "/manifest.mpd";
 }
 
 void HLSGenerator::onCleanupTimer()
 {
-    // Stub implementation
+    cleanupOldSegments();
 }
 
 void HLSGenerator::onStreamDataReceived(const QString& mountPoint, const QByteArray& data)
 {
-    // Stub implementation
-    Q_UNUSED(mountPoint)
-    Q_UNUSED(data)
+    if (!isRunning()) {
+        return;
+    }
+    generateSegment(mountPoint, data);
 }
 
-} // namespace LegacyStream 
\ No newline at end of file
+} // namespace LegacyStream
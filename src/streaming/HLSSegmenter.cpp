@@ -0,0 +1,466 @@
+#include "streaming/HLSSegmenter.h"
+
+#include <QtMath>
+
+#include <utility>
+
+namespace LegacyStream {
+
+namespace {
+
+const char TIMESTAMP_OWNER[] = "com.apple.streaming.transportStreamTimestamp";
+
+} // namespace
+
+HLSSegmenter::HLSSegmenter(int segmentDuration, int capacity)
+    : m_segmentDuration(qMax(1, segmentDuration))
+    , m_capacity(qMax(1, capacity))
+{
+}
+
+void HLSSegmenter::setSegmentDuration(int seconds)
+{
+    m_segmentDuration = qMax(1, seconds);
+}
+
+void HLSSegmenter::setCapacity(int segments)
+{
+    m_capacity = qMax(1, segments);
+    while (m_segments.size() > m_capacity) {
+        m_segments.removeFirst();
+    }
+}
+
+void HLSSegmenter::setPartDuration(int milliseconds)
+{
+    m_partDuration = qMax(0, milliseconds);
+}
+
+double HLSSegmenter::partTarget() const
+{
+    return m_partDuration / 1000.0;
+}
+
+void HLSSegmenter::setContainer(Container container)
+{
+    if (m_container != container) {
+        m_container = container;
+        reset();
+    }
+}
+
+void HLSSegmenter::alignTo(qint64 sequence, double seconds, bool discontinuity)
+{
+    if (m_sampleRate != 0 || !m_segments.isEmpty()) {
+        return;
+    }
+    m_nextSequence = sequence;
+    m_alignSeconds = qMax(0.0, seconds);
+    m_discontinuity = discontinuity;
+}
+
+double HLSSegmenter::position() const
+{
+    return m_sampleRate > 0 ? static_cast<double>(m_totalSamples + m_currentSamples) / m_sampleRate : 0.0;
+}
+
+void HLSSegmenter::reset()
+{
+    // Sequence numbers and timestamps carry on so clients see a
+    // discontinuity rather than a playlist that jumps backwards
+    m_codec = AudioFrameParser::Codec::UNKNOWN;
+    m_aligner.setCodec(m_codec);
+    m_sampleRate = 0;
+    m_channels = 0;
+    m_current.clear();
+    m_currentSamples = 0;
+    m_parts.clear();
+    m_partStart = 0;
+    m_partSamples = 0;
+    m_track = CMAFTrack();
+    m_fragmentSamples.clear();
+    m_fragmentPayload.clear();
+    m_fragmentDuration = 0;
+    m_oggPacket.clear();
+    m_discontinuity = m_nextSequence > 0;
+}
+
+QString HLSSegmenter::fileExtension() const
+{
+    if (isFragmented()) {
+        return "m4s";
+    }
+    return m_codec == AudioFrameParser::Codec::MP3 ? "mp3" : "aac";
+}
+
+QString HLSSegmenter::contentType() const
+{
+    if (isFragmented()) {
+        return "audio/mp4";
+    }
+    return m_codec == AudioFrameParser::Codec::MP3 ? "audio/mpeg" : "audio/aac";
+}
+
+QString HLSSegmenter::codecsAttribute() const
+{
+    if (isFragmented() && m_track.isValid()) {
+        return m_track.codecsAttribute();
+    }
+    return m_codec == AudioFrameParser::Codec::MP3 ? "mp4a.40.34" : "mp4a.40.2";
+}
+
+bool HLSSegmenter::detectCodec(const QByteArray& data)
+{
+    const uchar* p = reinterpret_cast<const uchar*>(data.constData());
+    const qint64 mp3 = AudioFrameParser::findFrameStart(AudioFrameParser::Codec::MP3, p, data.size());
+    const qint64 adts = AudioFrameParser::findFrameStart(AudioFrameParser::Codec::AAC_ADTS, p, data.size());
+    if (data.startsWith("OggS")) {
+        // Ogg carries other codecs too; only Opus can be packaged
+        if (data.indexOf("OpusHead") < 0) {
+            return false;
+        }
+        m_codec = AudioFrameParser::Codec::OGG_OPUS;
+        m_aligner.setCodec(m_codec);
+        return true;
+    }
+    if (mp3 < 0 && adts < 0) {
+        return false;
+    }
+
+    m_codec = (adts >= 0 && (mp3 < 0 || adts < mp3)) ? AudioFrameParser::Codec::AAC_ADTS
+                                                      : AudioFrameParser::Codec::MP3;
+    m_aligner.setCodec(m_codec);
+    return true;
+}
+
+int HLSSegmenter::push(const QByteArray& data, int* parts)
+{
+    m_completedParts = 0;
+    if (parts) {
+        *parts = 0;
+    }
+    if (m_codec == AudioFrameParser::Codec::UNKNOWN && !detectCodec(data)) {
+        return 0;
+    }
+
+    const QByteArray frames = m_aligner.push(data);
+    const uchar* p = reinterpret_cast<const uchar*>(frames.constData());
+    const qint64 size = frames.size();
+    const int before = static_cast<int>(m_nextSequence);
+
+    // The aligner hands over whole frames only, so walk them one by one
+    // and cut as soon as a frame takes the segment to its target length
+    AudioFrameInfo info;
+    qint64 pos = 0;
+    while (pos < size) {
+        if (AudioFrameParser::parse(m_codec, p + pos, size - pos, info) != AudioFrameParser::Result::Frame) {
+            break;
+        }
+        if (m_sampleRate != info.sampleRate || m_channels != info.channels) {
+            // Format change: close the segment so each one is homogeneous
+            if (m_currentSamples > 0) {
+                finishSegment();
+            }
+            m_discontinuity = m_discontinuity || m_sampleRate != 0;
+            if (m_sampleRate != 0) {
+                // Keep the timeline position in seconds across a rate change
+                m_totalSamples = m_totalSamples * info.sampleRate / m_sampleRate;
+            } else if (m_alignSeconds >= 0.0) {
+                m_totalSamples = qRound64(m_alignSeconds * info.sampleRate);
+                m_alignSeconds = -1.0;
+            }
+            m_sampleRate = info.sampleRate;
+            m_channels = info.channels;
+            m_track = CMAFTrack();
+        }
+
+        if (isFragmented()) {
+            addFragmentedFrame(p + pos, info);
+        } else {
+            addUnit(frames.constData() + pos, info.length, info.samples);
+        }
+        pos += info.length;
+    }
+
+    if (parts) {
+        *parts = m_completedParts;
+    }
+    return static_cast<int>(m_nextSequence) - before;
+}
+
+void HLSSegmenter::addUnit(const char* data, qint64 length, int samples)
+{
+    // Close the open part before a unit would push it past the target
+    if (m_partDuration > 0 && m_partSamples > 0 &&
+        (m_partSamples + samples) * 1000 > static_cast<qint64>(m_partDuration) * m_sampleRate) {
+        finishPart();
+    }
+
+    if (m_currentSamples == 0) {
+        // Close on the next grid line, not a fixed length from here, so a
+        // rendition that joined late or was cut short falls back in step
+        const qint64 gridSamples = static_cast<qint64>(m_segmentDuration) * m_sampleRate;
+        m_segmentEnd = (m_totalSamples / gridSamples + 1) * gridSamples;
+    }
+
+    appendFrame(data, length, samples);
+    if (m_totalSamples + m_currentSamples >= m_segmentEnd) {
+        finishSegment();
+    }
+}
+
+void HLSSegmenter::addFragmentedFrame(const uchar* frame, const AudioFrameInfo& info)
+{
+    const char* bytes = reinterpret_cast<const char*>(frame);
+
+    switch (m_codec) {
+        case AudioFrameParser::Codec::AAC_ADTS:
+            // MP4 samples are raw access units: drop the ADTS header
+            if (!m_track.isValid()) {
+                setTrack(CMAFTrack::fromAdts(frame, info.sampleRate, info.channels));
+            }
+            addUnit(bytes + info.headerBytes, info.length - info.headerBytes, info.samples);
+            break;
+
+        case AudioFrameParser::Codec::MP3:
+            if (!m_track.isValid()) {
+                setTrack(CMAFTrack::fromMp3(info.sampleRate, info.channels));
+            }
+            addUnit(bytes, info.length, info.samples);
+            break;
+
+        case AudioFrameParser::Codec::OGG_OPUS:
+            // Each Opus packet is one sample; the page framing goes
+            for (const OggPacket& packet : AudioFrameParser::oggPackets(frame, info.length, true)) {
+                const bool continued = packet.offset == info.headerBytes && AudioFrameParser::isOggContinued(frame);
+                if (!continued) {
+                    m_oggPacket.clear();
+                }
+                m_oggPacket.append(bytes + packet.offset, static_cast<int>(packet.length));
+                if (!packet.complete) {
+                    continue;
+                }
+
+                const uchar* data = reinterpret_cast<const uchar*>(m_oggPacket.constData());
+                if (m_oggPacket.startsWith("OpusHead")) {
+                    const CMAFTrack track = CMAFTrack::fromOpusHead(data, m_oggPacket.size());
+                    if (track.isValid()) {
+                        setTrack(track);
+                    }
+                } else if (m_track.isValid() && !m_oggPacket.startsWith("OpusTags")) {
+                    // Audio before the first OpusHead cannot be described, so it is dropped
+                    addUnit(m_oggPacket.constData(), m_oggPacket.size(),
+                            AudioFrameParser::opusPacketSamples(data, m_oggPacket.size()));
+                }
+                m_oggPacket.clear();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void HLSSegmenter::setTrack(const CMAFTrack& track)
+{
+    if (track == m_track) {
+        return;
+    }
+
+    // A new setup needs a new init segment, and the segments behind it
+    // must not share one with the frames before
+    if (m_track.isValid()) {
+        if (m_currentSamples > 0) {
+            finishSegment();
+        }
+        m_discontinuity = true;
+    }
+    m_track = track;
+    m_inits.insert(++m_initId, CMAFPackager::initSegment(track));
+}
+
+void HLSSegmenter::appendFrame(const char* data, qint64 length, int samples)
+{
+    if (isFragmented()) {
+        if (m_currentSamples == 0) {
+            m_currentStart = QDateTime::currentDateTimeUtc();
+        }
+        CMAFSample sample;
+        sample.size = static_cast<quint32>(length);
+        sample.duration = static_cast<quint32>(samples);
+        m_fragmentSamples.append(sample);
+        m_fragmentPayload.append(data, static_cast<int>(length));
+        m_fragmentDuration += samples;
+        m_currentSamples += samples;
+        m_partSamples += samples;
+        return;
+    }
+
+    if (m_current.isEmpty()) {
+        // Reserve for a whole segment up front to avoid regrowth per frame
+        const qint64 framesPerSegment = static_cast<qint64>(m_segmentDuration) * m_sampleRate / qMax(1, samples) + 1;
+        m_current.reserve(static_cast<int>(framesPerSegment * length + 64));
+        m_current.append(timestampTag(m_totalSamples, m_sampleRate));
+        m_currentStart = QDateTime::currentDateTimeUtc();
+    }
+
+    m_current.append(data, static_cast<int>(length));
+    m_currentSamples += samples;
+    m_partSamples += samples;
+}
+
+QByteArray HLSSegmenter::finishFragment()
+{
+    if (m_fragmentSamples.isEmpty()) {
+        return QByteArray();
+    }
+
+    // The decode time runs on across segments, so fragments line up on
+    // one timeline for both HLS and DASH
+    const quint64 decodeTime = static_cast<quint64>(m_totalSamples + m_currentSamples - m_fragmentDuration);
+    const QByteArray fragment = CMAFPackager::fragment(m_fragmentSequence++, decodeTime,
+                                                       m_fragmentSamples, m_fragmentPayload);
+    m_current.append(fragment);
+    m_fragmentSamples.clear();
+    m_fragmentPayload.clear();
+    m_fragmentDuration = 0;
+    return fragment;
+}
+
+void HLSSegmenter::finishPart()
+{
+    HLSPart part;
+    part.index = m_parts.size();
+    part.samples = m_partSamples;
+    part.sampleRate = m_sampleRate;
+    part.data = isFragmented() ? finishFragment() : m_current.mid(m_partStart);
+
+    m_partStart = m_current.size();
+    m_partSamples = 0;
+    m_parts.append(part);
+    ++m_completedParts;
+}
+
+void HLSSegmenter::finishSegment()
+{
+    if (m_partDuration > 0 && m_partSamples > 0) {
+        finishPart();
+    }
+    if (isFragmented()) {
+        finishFragment();
+    }
+
+    HLSSegment segment;
+    segment.sequence = m_nextSequence++;
+    segment.startSample = m_totalSamples;
+    segment.samples = m_currentSamples;
+    segment.sampleRate = m_sampleRate;
+    segment.programDateTime = m_currentStart;
+    segment.discontinuity = m_discontinuity;
+    segment.initId = isFragmented() ? m_initId : -1;
+    m_discontinuity = false;
+    segment.data = std::move(m_current);
+
+    segment.parts = std::move(m_parts);
+
+    if (segment.duration() > 0.0) {
+        m_peakBitrate = qMax(m_peakBitrate, static_cast<qint64>(segment.data.size() * 8 / segment.duration()));
+        m_producedBytes += segment.data.size();
+        m_producedSeconds += segment.duration();
+    }
+
+    m_totalSamples += m_currentSamples;
+    m_current = QByteArray();
+    m_currentSamples = 0;
+    m_parts = QVector<HLSPart>();
+    m_partStart = 0;
+    m_partSamples = 0;
+
+    if (m_segments.size() >= m_capacity) {
+        m_segments.removeFirst();
+    }
+    m_segments.append(segment);
+
+    // Parts are only listed for the newest segments
+    if (m_segments.size() > PART_HOLD_SEGMENTS) {
+        m_segments[m_segments.size() - 1 - PART_HOLD_SEGMENTS].parts.clear();
+    }
+
+    // Init segments live as long as a held segment refers to them
+    const int oldestInit = m_segments.first().initId >= 0 ? m_segments.first().initId : m_initId;
+    while (!m_inits.isEmpty() && m_inits.firstKey() < qMin(oldestInit, m_initId)) {
+        m_inits.erase(m_inits.begin());
+    }
+}
+
+const HLSPart* HLSSegmenter::part(qint64 sequence, int index) const
+{
+    const QVector<HLSPart>* parts = nullptr;
+    if (sequence == m_nextSequence) {
+        parts = &m_parts;
+    } else if (const HLSSegment* finished = segment(sequence)) {
+        parts = &finished->parts;
+    }
+
+    if (!parts || index < 0 || index >= parts->size()) {
+        return nullptr;
+    }
+    return &parts->at(index);
+}
+
+const HLSSegment* HLSSegmenter::segment(qint64 sequence) const
+{
+    if (m_segments.isEmpty() || sequence < firstSequence() || sequence > lastSequence()) {
+        return nullptr;
+    }
+    return &m_segments.at(static_cast<int>(sequence - firstSequence()));
+}
+
+int HLSSegmenter::targetDuration() const
+{
+    // EXTINF rounded to the nearest integer must not exceed this
+    double longest = m_segmentDuration;
+    for (const HLSSegment& segment : m_segments) {
+        longest = qMax(longest, segment.duration());
+    }
+    return qRound(longest);
+}
+
+qint64 HLSSegmenter::peakBitrate() const
+{
+    return m_peakBitrate;
+}
+
+qint64 HLSSegmenter::averageBitrate() const
+{
+    return m_producedSeconds > 0.0 ? static_cast<qint64>(m_producedBytes * 8 / m_producedSeconds) : 0;
+}
+
+QByteArray HLSSegmenter::timestampTag(qint64 startSample, int sampleRate)
+{
+    // Packed audio segments start with an ID3 PRIV frame carrying the
+    // 33-bit 90 kHz timestamp of the first sample (RFC 8216, 3.4)
+    const quint64 pts = static_cast<quint64>(startSample * 90000 / qMax(1, sampleRate)) & 0x1FFFFFFFFULL;
+    const int ownerLength = sizeof(TIMESTAMP_OWNER); // includes the terminator
+    const int frameSize = ownerLength + 8;
+
+    QByteArray tag;
+    tag.reserve(20 + frameSize);
+    tag.append("ID3", 3);
+    tag.append(char(4)).append(char(0)).append(char(0));
+    const int tagSize = 10 + frameSize;
+    tag.append(char((tagSize >> 21) & 0x7F)).append(char((tagSize >> 14) & 0x7F))
+       .append(char((tagSize >> 7) & 0x7F)).append(char(tagSize & 0x7F));
+
+    tag.append("PRIV", 4);
+    tag.append(char((frameSize >> 21) & 0x7F)).append(char((frameSize >> 14) & 0x7F))
+       .append(char((frameSize >> 7) & 0x7F)).append(char(frameSize & 0x7F));
+    tag.append(char(0)).append(char(0));
+    tag.append(TIMESTAMP_OWNER, ownerLength);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        tag.append(char((pts >> shift) & 0xFF));
+    }
+    return tag;
+}
+
+} // namespace LegacyStream
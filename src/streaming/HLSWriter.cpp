@@ -0,0 +1,416 @@
+#include "streaming/HLSWriter.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef LEGACYSTREAM_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace LegacyStream {
+
+namespace {
+
+#ifdef Q_OS_UNIX
+QString lastError()
+{
+    return QString::fromLocal8Bit(strerror(errno));
+}
+
+bool writeAll(int fd, const char* data, qint64 length, qint64 offset, QString* error)
+{
+    while (offset < length) {
+        const ssize_t written = ::pwrite(fd, data + offset, static_cast<size_t>(length - offset), offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            *error = lastError();
+            return false;
+        }
+        offset += written;
+    }
+    return true;
+}
+
+void syncDirectory(const QString& path)
+{
+    // Makes the renames durable; a failure here only costs durability
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+#endif
+
+} // namespace
+
+HLSWriter::HLSWriter(QObject* parent)
+    : QObject(parent)
+{
+    m_clock.start();
+}
+
+HLSWriter::~HLSWriter()
+{
+    stop();
+}
+
+bool HLSWriter::start(const QString& directory, int threads)
+{
+    stop();
+
+    if (!QDir().mkpath(directory)) {
+        qWarning() << "HLSWriter: Cannot create" << directory;
+        return false;
+    }
+    m_directory = QDir(directory).absolutePath();
+    m_stopping = false;
+    m_backend = Backend::ThreadPool;
+
+#ifdef LEGACYSTREAM_HAVE_LIBURING
+    // The kernel does the waiting, so one submitting thread is enough.
+    // Setup fails on old kernels and under some seccomp profiles.
+    auto* ring = new io_uring;
+    if (io_uring_queue_init(BATCH_SIZE * 2, ring, 0) == 0) {
+        m_ring = ring;
+        m_backend = Backend::IoUring;
+        threads = 1;
+    } else {
+        delete ring;
+    }
+#endif
+
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < qMax(1, threads); ++i) {
+        auto* worker = new Worker;
+        worker->thread = QThread::create([this, worker]() { run(worker); });
+        worker->thread->setObjectName(QString("HLSWriter-%1").arg(i));
+        m_workers.append(worker);
+        worker->thread->start();
+    }
+
+    qDebug() << "HLSWriter: Writing to" << m_directory << "with"
+             << (m_backend == Backend::IoUring ? "io_uring" : "thread pool") << m_workers.size();
+    return true;
+}
+
+void HLSWriter::stop()
+{
+    QVector<Worker*> workers;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        for (Worker* worker : m_workers) {
+            worker->wake.wakeAll();
+        }
+        workers.swap(m_workers);
+    }
+
+    for (Worker* worker : workers) {
+        worker->thread->wait();
+        delete worker->thread;
+        delete worker;
+    }
+
+#ifdef LEGACYSTREAM_HAVE_LIBURING
+    if (m_ring) {
+        io_uring_queue_exit(static_cast<io_uring*>(m_ring));
+        delete static_cast<io_uring*>(m_ring);
+        m_ring = nullptr;
+    }
+#endif
+}
+
+bool HLSWriter::write(const QString& path, const QByteArray& data)
+{
+    Job job;
+    job.path = QDir(m_directory).filePath(path);
+    job.data = data;
+    return enqueue(job);
+}
+
+bool HLSWriter::remove(const QString& path)
+{
+    Job job;
+    job.path = QDir(m_directory).filePath(path);
+    job.remove = true;
+    return enqueue(job);
+}
+
+bool HLSWriter::enqueue(Job job)
+{
+    job.queuedAt = m_clock.nsecsElapsed();
+
+    QMutexLocker locker(&m_mutex);
+    if (m_workers.isEmpty() || m_stopping) {
+        return false;
+    }
+
+    Worker* worker = m_workers.at(static_cast<int>(qHash(job.path) % uint(m_workers.size())));
+    for (int i = worker->queue.size() - 1; i >= 0; --i) {
+        Job& queued = worker->queue[i];
+        if (queued.path == job.path) {
+            // Newest content wins; keep the older timestamp so latency
+            // still counts from the first request for this file
+            job.queuedAt = queued.queuedAt;
+            queued = job;
+            return true;
+        }
+    }
+
+    if (m_queueDepth.load(std::memory_order_relaxed) >= m_maxQueueDepth) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        if (!m_stalled.exchange(true)) {
+            qWarning() << "HLSWriter: Queue full, dropping writes; disk at" << m_directory << "is stalled";
+        }
+        return false;
+    }
+
+    worker->queue.append(job);
+    m_queueDepth.fetch_add(1, std::memory_order_relaxed);
+    worker->wake.wakeOne();
+    return true;
+}
+
+void HLSWriter::run(Worker* worker)
+{
+    QVector<Job> batch;
+    batch.reserve(BATCH_SIZE);
+
+    forever {
+        {
+            QMutexLocker locker(&m_mutex);
+            while (worker->queue.isEmpty() && !m_stopping) {
+                worker->wake.wait(&m_mutex);
+            }
+            if (worker->queue.isEmpty()) {
+                return; // stopping and drained
+            }
+            while (!worker->queue.isEmpty() && batch.size() < BATCH_SIZE) {
+                batch.append(worker->queue.takeFirst());
+            }
+        }
+
+        writeBatch(batch);
+        if (m_queueDepth.fetch_sub(batch.size(), std::memory_order_relaxed) == batch.size() &&
+            m_stalled.exchange(false)) {
+            qDebug() << "HLSWriter: Queue drained, disk at" << m_directory << "has caught up";
+        }
+        batch.clear();
+    }
+}
+
+void HLSWriter::writeBatch(QVector<Job>& jobs)
+{
+#ifdef Q_OS_UNIX
+    struct Pending
+    {
+        const Job* job = nullptr;
+        QByteArray temporary;
+        int fd = -1;
+        QString error;
+    };
+
+    QVector<Pending> files;
+    files.reserve(jobs.size());
+    QSet<QString> directories;
+
+    for (const Job& job : jobs) {
+        if (job.remove) {
+            if (::unlink(QFile::encodeName(job.path).constData()) != 0 && errno != ENOENT) {
+                finishJob(job, lastError());
+            } else {
+                finishJob(job, QString());
+            }
+            continue;
+        }
+
+        const QString directory = QFileInfo(job.path).absolutePath();
+        if (!directories.contains(directory)) {
+            QDir().mkpath(directory);
+            directories.insert(directory);
+        }
+
+        Pending file;
+        file.job = &job;
+        file.temporary = QFile::encodeName(job.path + ".tmp");
+        file.fd = ::open(file.temporary.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (file.fd < 0) {
+            file.error = lastError();
+        }
+        files.append(file);
+    }
+
+    bool submitted = false;
+#ifdef LEGACYSTREAM_HAVE_LIBURING
+    if (m_ring) {
+        // One submission for the whole batch: each write is linked to
+        // its fdatasync, and the kernel runs the chains in parallel
+        auto* ring = static_cast<io_uring*>(m_ring);
+        int expected = 0;
+        for (int i = 0; i < files.size(); ++i) {
+            if (files[i].fd < 0) {
+                continue;
+            }
+            io_uring_sqe* sqe = io_uring_get_sqe(ring);
+            io_uring_prep_write(sqe, files[i].fd, files[i].job->data.constData(),
+                                static_cast<unsigned>(files[i].job->data.size()), 0);
+            io_uring_sqe_set_data64(sqe, static_cast<quint64>(i) << 1);
+            ++expected;
+            if (m_sync) {
+                sqe->flags |= IOSQE_IO_LINK;
+                sqe = io_uring_get_sqe(ring);
+                io_uring_prep_fsync(sqe, files[i].fd, IORING_FSYNC_DATASYNC);
+                io_uring_sqe_set_data64(sqe, (static_cast<quint64>(i) << 1) | 1);
+                ++expected;
+            }
+        }
+
+        if (expected == 0 || io_uring_submit_and_wait(ring, expected) >= 0) {
+            submitted = true;
+            for (int reaped = 0; reaped < expected; ++reaped) {
+                io_uring_cqe* cqe = nullptr;
+                if (io_uring_wait_cqe(ring, &cqe) < 0) {
+                    break;
+                }
+                const quint64 data = io_uring_cqe_get_data64(cqe);
+                const int res = cqe->res;
+                io_uring_cqe_seen(ring, cqe);
+
+                Pending& file = files[static_cast<int>(data >> 1)];
+                const bool isSync = data & 1;
+                if (!isSync && res >= 0 && res < file.job->data.size()) {
+                    // Short write breaks the link; finish it by hand
+                    if (writeAll(file.fd, file.job->data.constData(), file.job->data.size(), res, &file.error) &&
+                        m_sync && ::fdatasync(file.fd) != 0) {
+                        file.error = lastError();
+                    }
+                } else if (res < 0 && res != -ECANCELED && file.error.isEmpty()) {
+                    file.error = QString::fromLocal8Bit(strerror(-res));
+                }
+            }
+        }
+    }
+#endif
+
+    if (!submitted) {
+        // Everything is written before anything is synced, so the device
+        // sees the batch back to back and one journal commit can cover
+        // several files
+        for (Pending& file : files) {
+            if (file.fd >= 0) {
+                writeAll(file.fd, file.job->data.constData(), file.job->data.size(), 0, &file.error);
+            }
+        }
+        if (m_sync) {
+            for (Pending& file : files) {
+                if (file.fd >= 0 && file.error.isEmpty() && ::fdatasync(file.fd) != 0) {
+                    file.error = lastError();
+                }
+            }
+        }
+    }
+
+    for (Pending& file : files) {
+        if (file.fd >= 0) {
+            ::close(file.fd);
+        }
+        if (file.error.isEmpty() &&
+            ::rename(file.temporary.constData(), QFile::encodeName(file.job->path).constData()) != 0) {
+            file.error = lastError();
+        }
+        if (!file.error.isEmpty()) {
+            ::unlink(file.temporary.constData());
+        }
+    }
+
+    if (m_sync) {
+        for (const QString& directory : directories) {
+            syncDirectory(directory);
+        }
+    }
+
+    for (const Pending& file : files) {
+        finishJob(*file.job, file.error);
+    }
+#else
+    // No batching here: QSaveFile syncs and replaces each file on its own
+    for (const Job& job : jobs) {
+        if (job.remove) {
+            QFile::remove(job.path);
+            finishJob(job, QString());
+            continue;
+        }
+
+        QDir().mkpath(QFileInfo(job.path).absolutePath());
+        QSaveFile file(job.path);
+        file.setDirectWriteFallback(false);
+        if (!file.open(QIODevice::WriteOnly) || file.write(job.data) != job.data.size() || !file.commit()) {
+            finishJob(job, file.errorString());
+        } else {
+            finishJob(job, QString());
+        }
+    }
+#endif
+}
+
+void HLSWriter::finishJob(const Job& job, const QString& error)
+{
+    if (!error.isEmpty()) {
+        m_failed.fetch_add(1, std::memory_order_relaxed);
+        qWarning() << "HLSWriter: Failed to" << (job.remove ? "remove" : "write") << job.path << error;
+        emit writeFailed(job.path, error);
+        return;
+    }
+    if (job.remove) {
+        return;
+    }
+
+    const qint64 latency = m_clock.nsecsElapsed() - job.queuedAt;
+    m_written.fetch_add(1, std::memory_order_relaxed);
+    m_latencyTotal.fetch_add(latency, std::memory_order_relaxed);
+    qint64 max = m_latencyMax.load(std::memory_order_relaxed);
+    while (latency > max && !m_latencyMax.compare_exchange_weak(max, latency, std::memory_order_relaxed)) {
+    }
+}
+
+double HLSWriter::averageLatency() const
+{
+    const qint64 written = m_written.load(std::memory_order_relaxed);
+    return written > 0 ? m_latencyTotal.load(std::memory_order_relaxed) / 1e6 / written : 0.0;
+}
+
+double HLSWriter::maxLatency() const
+{
+    return m_latencyMax.load(std::memory_order_relaxed) / 1e6;
+}
+
+QJsonObject HLSWriter::statistics() const
+{
+    QJsonObject stats;
+    stats["backend"] = m_backend == Backend::IoUring ? "io_uring" : "threadpool";
+    stats["directory"] = m_directory;
+    stats["queueDepth"] = queueDepth();
+    stats["averageLatencyMs"] = averageLatency();
+    stats["maxLatencyMs"] = maxLatency();
+    stats["written"] = writtenFiles();
+    stats["failed"] = failedWrites();
+    stats["dropped"] = droppedWrites();
+    return stats;
+}
+
+} // namespace LegacyStream
@@ -1,12 +1,21 @@
 #include "streaming/HttpServer.h"
+#include "streaming/HLSGenerator.h"
+#include "streaming/StreamManager.h"
+
+#include <QDateTime>
 #include <QDebug>
+#include <QUrl>
+#include <QUrlQuery>
 
 namespace LegacyStream {
 
 HttpServer::HttpServer(QObject *parent)
     : QObject(parent)
     , m_isRunning(false)
+    , m_parkTimer(new QTimer(this))
 {
+    m_parkTimer->setInterval(1000);
+    connect(m_parkTimer, &QTimer::timeout, this, &HttpServer::onParkTimer);
     qDebug() << "HttpServer initialized";
 }
 
@@ -49,6 +58,17 @@ void HttpServer::setStreamManager(StreamManager* streamManager)
     m_streamManager = streamManager;
 }
 
+void HttpServer::setHLSGenerator(HLSGenerator* hlsGenerator)
+{
+    if (m_hlsGenerator) {
+        disconnect(m_hlsGenerator, nullptr, this, nullptr);
+    }
+    m_hlsGenerator = hlsGenerator;
+    if (m_hlsGenerator) {
+        connect(m_hlsGenerator, &HLSGenerator::mediaPlaylistPublished, this, &HttpServer::onPlaylistPublished);
+    }
+}
+
 void HttpServer::setSSLManager(SSLManager* sslManager)
 {
     // Stub implementation
@@ -67,6 +87,16 @@ bool HttpServer::start(int port)
         m_port = port;
     }
     qDebug() << "HttpServer: Starting on port" << m_port;
+
+    if (!m_tcpServer) {
+        m_tcpServer = new QTcpServer(this);
+        connect(m_tcpServer, &QTcpServer::newConnection, this, &HttpServer::onNewConnection);
+    }
+    if (!m_tcpServer->isListening() && !m_tcpServer->listen(QHostAddress(m_host), static_cast<quint16>(m_port))) {
+        emit errorOccurred(QString("Cannot listen on %1:%2: %3").arg(m_host).arg(m_port).arg(m_tcpServer->errorString()));
+        return false;
+    }
+
     m_isRunning = true;
     return true;
 }
@@ -74,7 +104,22 @@ bool HttpServer::start(int port)
 void HttpServer::stop()
 {
     qDebug() << "HttpServer: Stopping";
+    if (m_tcpServer) {
+        m_tcpServer->close();
+    }
+    for (QTcpSocket* socket : m_clients) {
+        endSession(socket);
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    m_clients.clear();
+    m_requestBuffers.clear();
+    m_parkedRequests.clear();
+    m_parkedSockets.clear();
+    m_parkTimer->stop();
     m_isRunning = false;
+    m_draining = false;
 }
 
 bool HttpServer::isRunning() const
@@ -96,24 +141,493 @@ QMap<QString, QVariant> HttpServer::getStats() const
 {
     QMap<QString, QVariant> stats;
     stats["totalConnections"] = m_totalRequests;
-    stats["currentListeners"] = m_clients.size();
+    stats["currentConnections"] = m_clients.size();
+    stats["currentListeners"] = m_sessions.size();
     stats["totalBytesServed"] = m_totalBytesServed;
     return stats;
 }
 
+UpgradeHandoff::State HttpServer::handoffState(bool includeConnections) const
+{
+    UpgradeHandoff::State state;
+    if (m_tcpServer && m_tcpServer->isListening()) {
+        state.listener = m_tcpServer->socketDescriptor();
+    }
+    if (!includeConnections) {
+        return state;
+    }
+
+    // Only connections between requests move: nothing parked and nothing
+    // left to write. Bytes already read travel along with the socket.
+    for (QTcpSocket* socket : m_clients) {
+        if (m_parkedSockets.contains(socket) || socket->bytesToWrite() > 0 ||
+            socket->state() != QAbstractSocket::ConnectedState) {
+            continue;
+        }
+
+        UpgradeHandoff::Connection connection;
+        connection.descriptor = socket->socketDescriptor();
+        connection.pending = m_requestBuffers.value(socket) + socket->peek(socket->bytesAvailable());
+        const quint64 id = m_sessions.value(socket);
+        if (id != 0 && m_streamManager) {
+            const ListenerSession session = m_streamManager->listenerRegistry().session(id);
+            connection.mountPoint = session.mountPoint;
+            connection.userAgentHash = session.userAgentHash;
+            connection.connectTime = session.connectTime;
+            connection.bytesSent = session.bytesSent;
+        }
+        state.connections.append(connection);
+    }
+    return state;
+}
+
+void HttpServer::releaseHandoff(const UpgradeHandoff::State& state)
+{
+    // Closing our copies leaves the successor's open
+    if (m_tcpServer) {
+        m_tcpServer->close();
+    }
+
+    QSet<qintptr> handedOver;
+    for (const UpgradeHandoff::Connection& connection : state.connections) {
+        handedOver.insert(connection.descriptor);
+    }
+
+    m_draining = true;
+    const QList<QTcpSocket*> clients = m_clients;
+    for (QTcpSocket* socket : clients) {
+        if (handedOver.contains(socket->socketDescriptor())) {
+            m_clients.removeAll(socket);
+            m_requestBuffers.remove(socket);
+            endSession(socket);
+            socket->disconnect(this);
+            socket->abort();
+            socket->deleteLater();
+        } else if (!m_parkedSockets.contains(socket)) {
+            socket->disconnectFromHost(); // after any pending write
+        }
+    }
+
+    qDebug() << "HttpServer: Handed over" << handedOver.size() << "connections, draining" << m_clients.size();
+    if (m_clients.isEmpty()) {
+        emit drained();
+    }
+}
+
+bool HttpServer::adoptListener(qintptr descriptor)
+{
+    if (!m_tcpServer) {
+        m_tcpServer = new QTcpServer(this);
+        connect(m_tcpServer, &QTcpServer::newConnection, this, &HttpServer::onNewConnection);
+    }
+    if (!m_tcpServer->setSocketDescriptor(descriptor)) {
+        emit errorOccurred(QString("Cannot adopt listening socket: %1").arg(m_tcpServer->errorString()));
+        return false;
+    }
+
+    m_port = m_tcpServer->serverPort();
+    m_host = m_tcpServer->serverAddress().toString();
+    qDebug() << "HttpServer: Adopted listening socket on port" << m_port;
+    return true;
+}
+
+bool HttpServer::adoptConnection(const UpgradeHandoff::Connection& connection)
+{
+    QTcpSocket* socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(connection.descriptor)) {
+        delete socket;
+        return false;
+    }
+    addClient(socket);
+
+    if (!connection.mountPoint.isEmpty() && m_streamManager) {
+        ListenerSession session;
+        session.mountPoint = connection.mountPoint;
+        session.address = getClientIP(socket);
+        session.userAgentHash = connection.userAgentHash;
+        session.connectTime = connection.connectTime;
+        session.bytesSent = connection.bytesSent;
+        const quint64 id = m_streamManager->listenerRegistry().restore(session);
+        if (id != 0) {
+            trackSession(socket, id);
+        }
+    }
+
+    if (!connection.pending.isEmpty()) {
+        processRequests(socket, connection.pending);
+    }
+    return true;
+}
+
 void HttpServer::onNewConnection()
 {
-    // Stub implementation
+    while (m_tcpServer->hasPendingConnections()) {
+        addClient(m_tcpServer->nextPendingConnection());
+    }
+}
+
+void HttpServer::addClient(QTcpSocket* socket)
+{
+    m_clients.append(socket);
+    connect(socket, &QTcpSocket::readyRead, this, &HttpServer::onClientReadyRead);
+    connect(socket, &QTcpSocket::disconnected, this, &HttpServer::onClientDisconnected);
+
+    const QString clientIP = getClientIP(socket);
+    emit clientConnected(clientIP);
+    emit connectionAccepted(clientIP);
 }
 
 void HttpServer::onClientDisconnected()
 {
-    // Stub implementation
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+
+    m_clients.removeAll(socket);
+    m_requestBuffers.remove(socket);
+    m_parkedSockets.remove(socket);
+    endSession(socket);
+
+    const QString clientIP = getClientIP(socket);
+    emit clientDisconnected(clientIP);
+    emit connectionClosed(clientIP);
+    socket->deleteLater();
+
+    if (m_draining && m_clients.isEmpty()) {
+        emit drained();
+    }
 }
 
 void HttpServer::onClientReadyRead()
 {
-    // Stub implementation
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+
+    QByteArray buffer = m_requestBuffers.take(socket);
+    buffer.append(socket->readAll());
+    processRequests(socket, buffer);
+}
+
+void HttpServer::processRequests(QTcpSocket* socket, QByteArray buffer)
+{
+    // Requests are header-only GETs; pipelined requests are handled in order,
+    // so nothing more is read while one is parked. Work on a copy: a handler
+    // may close the socket and drop its entry.
+    int end;
+    while (!m_parkedSockets.contains(socket) && (end = buffer.indexOf("\r\n\r\n")) >= 0 &&
+           m_clients.contains(socket)) {
+        const QString request = QString::fromLatin1(buffer.constData(), end);
+        buffer.remove(0, end + 4);
+        handleHttpRequest(socket, request);
+    }
+
+    if (buffer.size() > MAX_REQUEST_SIZE) {
+        sendErrorResponse(socket, 431, "Request Header Fields Too Large");
+        socket->disconnectFromHost();
+    } else if (!buffer.isEmpty() && m_clients.contains(socket)) {
+        m_requestBuffers.insert(socket, buffer);
+    }
+}
+
+void HttpServer::handleHttpRequest(QTcpSocket* socket, const QString& request)
+{
+    QString method;
+    QString path;
+    QMap<QString, QString> headers;
+    QString body;
+
+    if (!parseHttpRequest(request, method, path, headers, body)) {
+        sendErrorResponse(socket, 400, "Bad Request");
+        return;
+    }
+
+    ++m_totalRequests;
+    emit requestReceived(method, path, getClientIP(socket));
+    handleRoute(socket, method, path, headers, body);
+
+    // A parked request finishes when it is answered
+    if (!m_parkedSockets.contains(socket)) {
+        finishRequest(socket, headers);
+    }
+}
+
+void HttpServer::finishRequest(QTcpSocket* socket, const QMap<QString, QString>& headers)
+{
+    if (m_draining || headers.value("connection").compare("close", Qt::CaseInsensitive) == 0) {
+        socket->disconnectFromHost();
+    }
+}
+
+bool HttpServer::parseHttpRequest(const QString& request, QString& method, QString& path,
+                                  QMap<QString, QString>& headers, QString& body)
+{
+    const QStringList lines = request.split("\r\n");
+    const QStringList requestLine = lines.value(0).split(' ', Qt::SkipEmptyParts);
+    if (requestLine.size() < 3 || !requestLine.at(2).startsWith("HTTP/")) {
+        return false;
+    }
+
+    method = requestLine.at(0).toUpper();
+    path = extractPath(lines.at(0));
+    headers = extractHeaders(lines);
+    body.clear();
+    return !path.isEmpty();
+}
+
+QString HttpServer::extractPath(const QString& requestLine)
+{
+    return urlDecode(requestLine.section(' ', 1, 1));
+}
+
+QMap<QString, QString> HttpServer::extractHeaders(const QStringList& lines)
+{
+    QMap<QString, QString> headers;
+    for (int i = 1; i < lines.size(); ++i) {
+        const int colon = lines.at(i).indexOf(':');
+        if (colon > 0) {
+            headers.insert(lines.at(i).left(colon).trimmed().toLower(), lines.at(i).mid(colon + 1).trimmed());
+        }
+    }
+    return headers;
+}
+
+void HttpServer::handleRoute(QTcpSocket* socket, const QString& method, const QString& path,
+                             const QMap<QString, QString>& headers, const QString& body)
+{
+    Q_UNUSED(body)
+
+    if (method != "GET" && method != "HEAD") {
+        sendErrorResponse(socket, 405, "Method Not Allowed");
+        return;
+    }
+
+    const QString route = path.section('?', 0, 0);
+    m_requestCounts[route.section('/', 1, 1)]++;
+
+    if ((route.startsWith("/hls/") || route.startsWith("/dash/")) && m_hlsGenerator) {
+        if (!beginSession(socket, route, headers)) {
+            sendErrorResponse(socket, 503, "Mount point is being removed");
+            return;
+        }
+        handleHlsRequest(socket, method, route, path.section('?', 1), headers);
+        return;
+    }
+
+    sendErrorResponse(socket, 404, "Not Found");
+}
+
+bool HttpServer::beginSession(QTcpSocket* socket, const QString& route, const QMap<QString, QString>& headers)
+{
+    if (!m_streamManager || m_sessions.contains(socket)) {
+        return true;
+    }
+
+    // /hls/<mount>/... and /dash/<mount>/...; later requests on a kept-alive
+    // connection stay with the first mount. Listeners already on a
+    // draining mount keep it until they leave; new ones are turned away.
+    const QString mountPoint = "/" + route.section('/', 2, 2);
+    if (m_streamManager->getStreamInfo(mountPoint).draining) {
+        return false;
+    }
+
+    ListenerRegistry& registry = m_streamManager->listenerRegistry();
+    const quint64 id = registry.connect(mountPoint, getClientIP(socket), headers.value("user-agent").toUtf8());
+    if (id != 0) {
+        trackSession(socket, id);
+    }
+    return true;
+}
+
+void HttpServer::trackSession(QTcpSocket* socket, quint64 id)
+{
+    ListenerRegistry& registry = m_streamManager->listenerRegistry();
+    m_sessions.insert(socket, id);
+    connect(socket, &QTcpSocket::bytesWritten, this, [&registry, id](qint64 bytes) {
+        registry.addBytesSent(id, bytes);
+    });
+}
+
+void HttpServer::endSession(QTcpSocket* socket)
+{
+    const quint64 id = m_sessions.take(socket);
+    if (id != 0 && m_streamManager) {
+        m_streamManager->listenerRegistry().disconnect(id);
+    }
+}
+
+void HttpServer::handleHlsRequest(QTcpSocket* socket, const QString& method, const QString& path,
+                                  const QString& query, const QMap<QString, QString>& headers)
+{
+    // Playlists are pre-rendered responses shared by every client: answer
+    // with one write of the existing buffer, or its 304 twin
+    if (const auto playlist = m_hlsGenerator->getPlaylist(path)) {
+        // Blocking reload: hold the request until the playlist contains
+        // the requested segment or part
+        const QUrlQuery params(query);
+        if (params.hasQueryItem("_HLS_msn") && playlist->lastSequence >= 0) {
+            bool ok = false;
+            const qint64 msn = params.queryItemValue("_HLS_msn").toLongLong(&ok);
+            const int part = params.hasQueryItem("_HLS_part") ? params.queryItemValue("_HLS_part").toInt(&ok) : -1;
+            if (!ok || msn > playlist->lastSequence + 2) {
+                sendErrorResponse(socket, 400, "Bad Request");
+                return;
+            }
+            if (!playlist->contains(msn, part)) {
+                parkRequest(path, playlist->targetDuration, socket, method, path, query, headers);
+                return;
+            }
+        }
+
+        if (headers.value("if-none-match").toLatin1() == playlist->etag) {
+            socket->write(playlist->notModified);
+            m_totalBytesServed += playlist->notModified.size();
+        } else if (method == "HEAD") {
+            socket->write(playlist->response.constData(), playlist->headerLength);
+            m_totalBytesServed += playlist->headerLength;
+        } else {
+            socket->write(playlist->response);
+            m_totalBytesServed += playlist->response.size();
+        }
+        return;
+    }
+
+    QByteArray body;
+    QString contentType;
+    if (!m_hlsGenerator->handleRequest(path, body, contentType)) {
+        // A request for the part named by the preload hint waits for it
+        const QString file = path.section('/', -1);
+        const QString playlistPath = path.section('/', 0, -2) + "/index.m3u8";
+        const auto playlist = file.count('.') == 2 ? m_hlsGenerator->getPlaylist(playlistPath) : nullptr;
+        if (playlist) {
+            const qint64 msn = file.section('.', 0, 0).toLongLong();
+            const int part = file.section('.', 1, 1).toInt();
+            const bool hinted = (msn == playlist->lastSequence + 1 && part == playlist->pendingParts) ||
+                                (msn == playlist->lastSequence + 2 && part == 0);
+            if (hinted) {
+                parkRequest(playlistPath, playlist->targetDuration, socket, method, path, query, headers);
+                return;
+            }
+        }
+        sendErrorResponse(socket, 404, "Not Found");
+        return;
+    }
+
+    // Segments never change once published
+    QMap<QString, QString> extraHeaders;
+    extraHeaders["Access-Control-Allow-Origin"] = "*";
+    extraHeaders["Cache-Control"] = "public, max-age=3600, immutable";
+    sendHttpResponse(socket, 200, "OK", contentType, method == "HEAD" ? QByteArray() : body, extraHeaders);
+}
+
+void HttpServer::parkRequest(const QString& playlistPath, int targetDuration, QTcpSocket* socket,
+                             const QString& method, const QString& path, const QString& query,
+                             const QMap<QString, QString>& headers)
+{
+    // Give up after three target durations, as the LL-HLS spec allows
+    ParkedRequest request;
+    request.socket = socket;
+    request.method = method;
+    request.path = path;
+    request.query = query;
+    request.headers = headers;
+    request.deadline = QDateTime::currentMSecsSinceEpoch() + qMax(1, targetDuration) * 3000;
+
+    m_parkedRequests[playlistPath].append(request);
+    m_parkedSockets.insert(socket);
+    if (!m_parkTimer->isActive()) {
+        m_parkTimer->start();
+    }
+}
+
+void HttpServer::onPlaylistPublished(const QString& playlistPath)
+{
+    const QVector<ParkedRequest> waiting = m_parkedRequests.take(playlistPath);
+    for (const ParkedRequest& request : waiting) {
+        QTcpSocket* socket = request.socket;
+        if (!socket || !m_clients.contains(socket)) {
+            continue;
+        }
+
+        // Run the request again; one still unsatisfied parks itself anew
+        m_parkedSockets.remove(socket);
+        handleHlsRequest(socket, request.method, request.path, request.query, request.headers);
+        if (!m_parkedSockets.contains(socket)) {
+            finishRequest(socket, request.headers);
+            processRequests(socket, m_requestBuffers.take(socket));
+        }
+    }
+}
+
+void HttpServer::onParkTimer()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QList<ParkedRequest> expired;
+    for (auto it = m_parkedRequests.begin(); it != m_parkedRequests.end();) {
+        QVector<ParkedRequest>& requests = it.value();
+        for (int i = requests.size() - 1; i >= 0; --i) {
+            if (!requests.at(i).socket || requests.at(i).deadline <= now) {
+                expired.append(requests.takeAt(i));
+            }
+        }
+        if (requests.isEmpty()) {
+            it = m_parkedRequests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (const ParkedRequest& request : expired) {
+        QTcpSocket* socket = request.socket;
+        if (!socket || !m_clients.contains(socket)) {
+            continue;
+        }
+        m_parkedSockets.remove(socket);
+        sendErrorResponse(socket, 503, "Service Unavailable");
+        finishRequest(socket, request.headers);
+        processRequests(socket, m_requestBuffers.take(socket));
+    }
+
+    if (m_parkedRequests.isEmpty()) {
+        m_parkTimer->stop();
+    }
+}
+
+void HttpServer::sendHttpResponse(QTcpSocket* socket, int statusCode, const QString& statusText,
+                                  const QString& contentType, const QByteArray& body,
+                                  const QMap<QString, QString>& extraHeaders)
+{
+    QByteArray header;
+    header.reserve(256);
+    header += QString("HTTP/1.1 %1 %2\r\n").arg(statusCode).arg(statusText).toLatin1();
+    header += "Content-Type: " + contentType.toLatin1() + "\r\n";
+    header += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    header += "Server: LegacyStream\r\n";
+    for (auto it = extraHeaders.constBegin(); it != extraHeaders.constEnd(); ++it) {
+        header += it.key().toLatin1() + ": " + it.value().toLatin1() + "\r\n";
+    }
+    header += "\r\n";
+
+    socket->write(header);
+    socket->write(body);
+    m_totalBytesServed += header.size() + body.size();
+}
+
+void HttpServer::sendErrorResponse(QTcpSocket* socket, int statusCode, const QString& message)
+{
+    sendHttpResponse(socket, statusCode, message, "text/plain", message.toUtf8() + "\n");
+}
+
+QString HttpServer::urlDecode(const QString& encoded) const
+{
+    return QUrl::fromPercentEncoding(encoded.toLatin1());
+}
+
+QString HttpServer::getClientIP(QTcpSocket* socket) const
+{
+    return socket->peerAddress().toString();
 }
 
 } // namespace LegacyStream 
\ No newline at end of file
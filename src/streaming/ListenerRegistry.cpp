@@ -0,0 +1,232 @@
+#include "streaming/ListenerRegistry.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QMutexLocker>
+
+namespace LegacyStream {
+
+ListenerRegistry::ListenerRegistry()
+{
+    for (auto& chunk : m_chunks) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ListenerRegistry::~ListenerRegistry()
+{
+    for (int i = 0; i < m_chunkCount; ++i) {
+        delete[] m_chunks[i].load(std::memory_order_relaxed);
+    }
+}
+
+ListenerRegistry::Slot* ListenerRegistry::slot(int index) const
+{
+    Slot* chunk = m_chunks[index >> CHUNK_BITS].load(std::memory_order_acquire);
+    return chunk ? &chunk[index & (CHUNK_SIZE - 1)] : nullptr;
+}
+
+bool ListenerRegistry::grow()
+{
+    if (m_chunkCount == MAX_CHUNKS) {
+        return false;
+    }
+
+    Slot* chunk = new Slot[CHUNK_SIZE];
+    const int base = m_chunkCount << CHUNK_BITS;
+    for (int i = CHUNK_SIZE - 1; i >= 0; --i) {
+        chunk[i].next = m_freeHead;
+        m_freeHead = base + i;
+    }
+    // Published last: lock-free readers only follow ids handed out after it
+    m_chunks[m_chunkCount++].store(chunk, std::memory_order_release);
+    return true;
+}
+
+ListenerRegistry::Mount* ListenerRegistry::mountFor(const QString& mountPoint)
+{
+    Mount*& mount = m_mountIndex[mountPoint];
+    if (!mount) {
+        m_mounts.push_back(std::make_unique<Mount>());
+        mount = m_mounts.back().get();
+        mount->mountPoint = mountPoint;
+    }
+    return mount;
+}
+
+quint64 ListenerRegistry::connect(const QString& mountPoint, const QString& address, const QByteArray& userAgent)
+{
+    return open(mountPoint, address, qHash(userAgent), QDateTime::currentMSecsSinceEpoch(), 0);
+}
+
+quint64 ListenerRegistry::restore(const ListenerSession& session)
+{
+    return open(session.mountPoint, session.address, session.userAgentHash, session.connectTime, session.bytesSent);
+}
+
+quint64 ListenerRegistry::open(const QString& mountPoint, const QString& address, quint32 userAgentHash,
+                               qint64 connectTime, qint64 bytesSent)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_freeHead < 0 && !grow()) {
+        qWarning() << "ListenerRegistry: Session table full";
+        return 0;
+    }
+
+    const int index = m_freeHead;
+    Slot* session = slot(index);
+    m_freeHead = session->next;
+
+    Mount* mount = mountFor(mountPoint);
+    session->prev = -1;
+    session->next = mount->head;
+    if (mount->head >= 0) {
+        slot(mount->head)->prev = index;
+    }
+    mount->head = index;
+
+    session->address = address;
+    session->userAgentHash = userAgentHash;
+    session->connectTime = connectTime;
+    session->bytesSent.store(bytesSent, std::memory_order_relaxed);
+    session->mount.store(mount, std::memory_order_relaxed);
+    const quint32 generation = session->generation.load(std::memory_order_relaxed) + 1;
+    session->generation.store(generation, std::memory_order_release);
+
+    mount->counters.listeners.fetch_add(1, std::memory_order_relaxed);
+    m_shards[index % SHARDS].listeners.fetch_add(1, std::memory_order_relaxed);
+    return (quint64(generation) << 32) | quint32(index);
+}
+
+bool ListenerRegistry::disconnect(quint64 id)
+{
+    const quint32 index = static_cast<quint32>(id);
+    const quint32 generation = static_cast<quint32>(id >> 32);
+
+    QMutexLocker locker(&m_mutex);
+    Slot* session = index < quint32(m_chunkCount << CHUNK_BITS) ? slot(static_cast<int>(index)) : nullptr;
+    if (!session || session->generation.load(std::memory_order_relaxed) != generation) {
+        return false;
+    }
+
+    Mount* mount = session->mount.load(std::memory_order_relaxed);
+    if (session->prev >= 0) {
+        slot(session->prev)->next = session->next;
+    } else {
+        mount->head = session->next;
+    }
+    if (session->next >= 0) {
+        slot(session->next)->prev = session->prev;
+    }
+
+    // Back to odd first, so a late addBytesSent() for this id misses
+    session->generation.store(generation + 1, std::memory_order_release);
+    session->address.clear();
+    session->next = m_freeHead;
+    m_freeHead = static_cast<int>(index);
+
+    mount->counters.listeners.fetch_sub(1, std::memory_order_relaxed);
+    m_shards[index % SHARDS].listeners.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+void ListenerRegistry::addBytesSent(quint64 id, qint64 bytes)
+{
+    const quint32 index = static_cast<quint32>(id);
+    if (index >= quint32(MAX_CHUNKS) << CHUNK_BITS) {
+        return;
+    }
+    Slot* session = slot(static_cast<int>(index));
+    if (!session || session->generation.load(std::memory_order_acquire) != static_cast<quint32>(id >> 32)) {
+        return;
+    }
+
+    session->bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+    session->mount.load(std::memory_order_relaxed)->counters.bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+    m_shards[index % SHARDS].bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+int ListenerRegistry::totalListeners() const
+{
+    int total = 0;
+    for (const Shard& shard : m_shards) {
+        total += shard.listeners.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+qint64 ListenerRegistry::totalBytesSent() const
+{
+    qint64 total = 0;
+    for (const Shard& shard : m_shards) {
+        total += shard.bytesSent.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+const ListenerCounters* ListenerRegistry::counters(const QString& mountPoint)
+{
+    QMutexLocker locker(&m_mutex);
+    return &mountFor(mountPoint)->counters;
+}
+
+int ListenerRegistry::listenerCount(const QString& mountPoint) const
+{
+    QMutexLocker locker(&m_mutex);
+    const Mount* mount = m_mountIndex.value(mountPoint);
+    return mount ? mount->counters.listeners.load(std::memory_order_relaxed) : 0;
+}
+
+qint64 ListenerRegistry::bytesSent(const QString& mountPoint) const
+{
+    QMutexLocker locker(&m_mutex);
+    const Mount* mount = m_mountIndex.value(mountPoint);
+    return mount ? mount->counters.bytesSent.load(std::memory_order_relaxed) : 0;
+}
+
+ListenerSession ListenerRegistry::session(quint64 id) const
+{
+    const quint32 index = static_cast<quint32>(id);
+    ListenerSession info;
+
+    QMutexLocker locker(&m_mutex);
+    const Slot* session = index < quint32(m_chunkCount << CHUNK_BITS) ? slot(static_cast<int>(index)) : nullptr;
+    if (!session || session->generation.load(std::memory_order_relaxed) != static_cast<quint32>(id >> 32)) {
+        return info;
+    }
+
+    info.id = id;
+    info.mountPoint = session->mount.load(std::memory_order_relaxed)->mountPoint;
+    info.address = session->address;
+    info.userAgentHash = session->userAgentHash;
+    info.connectTime = session->connectTime;
+    info.bytesSent = session->bytesSent.load(std::memory_order_relaxed);
+    return info;
+}
+
+QVector<ListenerSession> ListenerRegistry::sessions(const QString& mountPoint) const
+{
+    QMutexLocker locker(&m_mutex);
+    QVector<ListenerSession> result;
+    const Mount* mount = m_mountIndex.value(mountPoint);
+    if (!mount) {
+        return result;
+    }
+
+    result.reserve(mount->counters.listeners.load(std::memory_order_relaxed));
+    for (int index = mount->head; index >= 0;) {
+        const Slot* session = slot(index);
+        ListenerSession info;
+        info.id = (quint64(session->generation.load(std::memory_order_relaxed)) << 32) | quint32(index);
+        info.mountPoint = mountPoint;
+        info.address = session->address;
+        info.userAgentHash = session->userAgentHash;
+        info.connectTime = session->connectTime;
+        info.bytesSent = session->bytesSent.load(std::memory_order_relaxed);
+        result.append(info);
+        index = session->next;
+    }
+    return result;
+}
+
+} // namespace LegacyStream
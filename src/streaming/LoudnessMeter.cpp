@@ -0,0 +1,383 @@
+#include "streaming/LoudnessMeter.h"
+
+#include <QtMath>
+#include <cmath>
+
+namespace LegacyStream {
+
+namespace {
+
+// ITU-R BS.1770-4 Annex 2 true-peak interpolation filter (4x, 48 taps, 4 phases)
+constexpr double TRUE_PEAK_PHASES[4][12] = {
+    { 0.0017089843750,  0.0109863281250, -0.0196533203125,  0.0332031250000,
+     -0.0594482421875,  0.1373291015625,  0.9721679687500, -0.1022949218750,
+      0.0476074218750, -0.0266113281250,  0.0148925781250, -0.0083007812500 },
+    {-0.0291748046875,  0.0292968750000, -0.0517578125000,  0.0891113281250,
+     -0.1665039062500,  0.4650878906250,  0.7797851562500, -0.2003173828125,
+      0.1015625000000, -0.0582275390625,  0.0330810546875, -0.0189208984375 },
+    {-0.0189208984375,  0.0330810546875, -0.0582275390625,  0.1015625000000,
+     -0.2003173828125,  0.7797851562500,  0.4650878906250, -0.1665039062500,
+      0.0891113281250, -0.0517578125000,  0.0292968750000, -0.0291748046875 },
+    {-0.0083007812500,  0.0148925781250, -0.0266113281250,  0.0476074218750,
+     -0.1022949218750,  0.9721679687500,  0.1373291015625, -0.0594482421875,
+      0.0332031250000, -0.0196533203125,  0.0109863281250,  0.0017089843750 }
+};
+
+} // namespace
+
+LoudnessMeter::LoudnessMeter(int sampleRate, int channels)
+{
+    configure(sampleRate, channels);
+}
+
+void LoudnessMeter::configure(int sampleRate, int channels)
+{
+    m_sampleRate = qMax(8000, sampleRate);
+    m_channels = qBound(1, channels, 8);
+    m_subBlockFrames = qMax(1, qRound(m_sampleRate / 10.0));
+
+    m_channelState.assign(m_channels, ChannelState());
+    m_frameScratch.assign(m_channels, 0.0f);
+
+    // BS.1770 channel weights: surrounds get +1.5 dB, LFE is excluded
+    if (m_channels == 5) {
+        m_channelState[3].weight = 1.41;
+        m_channelState[4].weight = 1.41;
+    } else if (m_channels >= 6) {
+        m_channelState[3].weight = 0.0;
+        m_channelState[4].weight = 1.41;
+        m_channelState[5].weight = 1.41;
+    }
+
+    designFilters();
+    reset();
+}
+
+void LoudnessMeter::designFilters()
+{
+    // Stage 1: high shelf modelling the acoustic effect of the head
+    {
+        const double f0 = 1681.974450955533;
+        const double gain = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = std::tan(M_PI * f0 / m_sampleRate);
+        const double vh = std::pow(10.0, gain / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+
+        m_shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        m_shelf.b1 = 2.0 * (k * k - vh) / a0;
+        m_shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        m_shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        m_shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    // Stage 2: RLB high-pass
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = std::tan(M_PI * f0 / m_sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+
+        m_highPass.b0 = 1.0;
+        m_highPass.b1 = -2.0;
+        m_highPass.b2 = 1.0;
+        m_highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        m_highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+}
+
+void LoudnessMeter::reset()
+{
+    for (ChannelState& state : m_channelState) {
+        const double weight = state.weight;
+        state = ChannelState();
+        state.weight = weight;
+    }
+
+    m_subBlockSum = 0.0;
+    m_subBlockPos = 0;
+    m_subBlocks.fill(0.0);
+    m_subBlockIndex = 0;
+    m_subBlockCount = 0;
+
+    resetIntegrated();
+}
+
+void LoudnessMeter::resetIntegrated()
+{
+    m_integratedHistogram.clear();
+    m_rangeHistogram.clear();
+    m_integratedSubBlocks = 0;
+    m_truePeak = 0.0;
+}
+
+void LoudnessMeter::process(const qint16* samples, qint64 frames)
+{
+    if (!samples || frames <= 0) {
+        return;
+    }
+
+    float* frame = m_frameScratch.data();
+    for (qint64 i = 0; i < frames; ++i) {
+        const qint16* in = samples + i * m_channels;
+        for (int ch = 0; ch < m_channels; ++ch) {
+            frame[ch] = in[ch] / 32768.0f;
+        }
+        processFrame(frame);
+    }
+}
+
+void LoudnessMeter::process(const float* samples, qint64 frames)
+{
+    if (!samples || frames <= 0) {
+        return;
+    }
+
+    for (qint64 i = 0; i < frames; ++i) {
+        processFrame(samples + i * m_channels);
+    }
+}
+
+inline void LoudnessMeter::processFrame(const float* frame)
+{
+    double weighted = 0.0;
+
+    for (int ch = 0; ch < m_channels; ++ch) {
+        ChannelState& state = m_channelState[ch];
+        const double x = frame[ch];
+
+        // K-weighting, two cascaded biquads in transposed direct form II
+        const double y1 = m_shelf.b0 * x + state.z1[0];
+        state.z1[0] = m_shelf.b1 * x - m_shelf.a1 * y1 + state.z2[0];
+        state.z2[0] = m_shelf.b2 * x - m_shelf.a2 * y1;
+
+        const double y2 = m_highPass.b0 * y1 + state.z1[1];
+        state.z1[1] = m_highPass.b1 * y1 - m_highPass.a1 * y2 + state.z2[1];
+        state.z2[1] = m_highPass.b2 * y1 - m_highPass.a2 * y2;
+
+        weighted += state.weight * y2 * y2;
+
+        const double peak = truePeakSample(state, frame[ch]);
+        if (peak > m_truePeak) {
+            m_truePeak = peak;
+        }
+    }
+
+    m_subBlockSum += weighted;
+    if (++m_subBlockPos >= m_subBlockFrames) {
+        finishSubBlock();
+    }
+}
+
+double LoudnessMeter::truePeakSample(ChannelState& state, float sample) const
+{
+    state.history[state.historyPos] = sample;
+
+    double peak = qAbs(static_cast<double>(sample));
+    for (int phase = 0; phase < 4; ++phase) {
+        double acc = 0.0;
+        int pos = state.historyPos;
+        for (int tap = 0; tap < 12; ++tap) {
+            acc += TRUE_PEAK_PHASES[phase][tap] * state.history[pos];
+            pos = (pos == 0) ? 11 : pos - 1;
+        }
+        peak = qMax(peak, qAbs(acc));
+    }
+
+    state.historyPos = (state.historyPos + 1) % 12;
+    return peak;
+}
+
+void LoudnessMeter::finishSubBlock()
+{
+    m_subBlocks[m_subBlockIndex] = m_subBlockSum;
+    m_subBlockIndex = (m_subBlockIndex + 1) % SHORT_TERM_SUBBLOCKS;
+    ++m_subBlockCount;
+    m_subBlockSum = 0.0;
+    m_subBlockPos = 0;
+
+    // Gating blocks are 400ms with 75% overlap, i.e. one per sub-block
+    if (m_subBlockCount >= MOMENTARY_SUBBLOCKS) {
+        const double energy = windowEnergy(MOMENTARY_SUBBLOCKS);
+        const double loudness = energyToLoudness(energy);
+        if (loudness > ABSOLUTE_GATE) {
+            m_integratedHistogram.add(energy, loudness);
+        }
+        ++m_integratedSubBlocks;
+    }
+
+    if (m_subBlockCount >= SHORT_TERM_SUBBLOCKS) {
+        const double energy = windowEnergy(SHORT_TERM_SUBBLOCKS);
+        const double loudness = energyToLoudness(energy);
+        if (loudness > ABSOLUTE_GATE) {
+            m_rangeHistogram.add(energy, loudness);
+        }
+    }
+}
+
+double LoudnessMeter::windowEnergy(int subBlocks) const
+{
+    const int available = static_cast<int>(qMin<quint64>(subBlocks, m_subBlockCount));
+    double sum = 0.0;
+    int index = m_subBlockIndex;
+    for (int i = 0; i < available; ++i) {
+        index = (index == 0) ? SHORT_TERM_SUBBLOCKS - 1 : index - 1;
+        sum += m_subBlocks[index];
+    }
+    return sum / (static_cast<double>(subBlocks) * m_subBlockFrames);
+}
+
+double LoudnessMeter::momentaryLoudness() const
+{
+    return qMax(ABSOLUTE_GATE, energyToLoudness(windowEnergy(MOMENTARY_SUBBLOCKS)));
+}
+
+double LoudnessMeter::shortTermLoudness() const
+{
+    return qMax(ABSOLUTE_GATE, energyToLoudness(windowEnergy(SHORT_TERM_SUBBLOCKS)));
+}
+
+double LoudnessMeter::integratedLoudness() const
+{
+    const GatingHistogram& hist = m_integratedHistogram;
+    if (hist.total == 0) {
+        return ABSOLUTE_GATE;
+    }
+
+    double totalEnergy = 0.0;
+    for (int i = 0; i < HISTOGRAM_BINS; ++i) {
+        totalEnergy += hist.energy[i];
+    }
+
+    const double relativeGate = energyToLoudness(totalEnergy / hist.total) + RELATIVE_GATE;
+    const int start = hist.binForLoudness(relativeGate);
+
+    double gatedEnergy = 0.0;
+    quint64 gatedCount = 0;
+    for (int i = start; i < HISTOGRAM_BINS; ++i) {
+        gatedEnergy += hist.energy[i];
+        gatedCount += hist.counts[i];
+    }
+
+    if (gatedCount == 0) {
+        return ABSOLUTE_GATE;
+    }
+    return qMax(ABSOLUTE_GATE, energyToLoudness(gatedEnergy / gatedCount));
+}
+
+double LoudnessMeter::loudnessRange() const
+{
+    const GatingHistogram& hist = m_rangeHistogram;
+    if (hist.total == 0) {
+        return 0.0;
+    }
+
+    double totalEnergy = 0.0;
+    for (int i = 0; i < HISTOGRAM_BINS; ++i) {
+        totalEnergy += hist.energy[i];
+    }
+
+    const double relativeGate = energyToLoudness(totalEnergy / hist.total) + LRA_RELATIVE_GATE;
+    const int start = hist.binForLoudness(relativeGate);
+
+    quint64 gatedCount = 0;
+    for (int i = start; i < HISTOGRAM_BINS; ++i) {
+        gatedCount += hist.counts[i];
+    }
+    if (gatedCount == 0) {
+        return 0.0;
+    }
+
+    // EBU Tech 3342: difference between the 10th and 95th percentiles
+    const double lowTarget = 0.10 * gatedCount;
+    const double highTarget = 0.95 * gatedCount;
+    int lowBin = -1;
+    int highBin = -1;
+    quint64 cumulative = 0;
+    for (int i = start; i < HISTOGRAM_BINS; ++i) {
+        cumulative += hist.counts[i];
+        if (lowBin < 0 && cumulative > lowTarget) {
+            lowBin = i;
+        }
+        if (cumulative > highTarget) {
+            highBin = i;
+            break;
+        }
+    }
+
+    if (lowBin < 0 || highBin < 0) {
+        return 0.0;
+    }
+    return (highBin - lowBin) * HISTOGRAM_STEP;
+}
+
+double LoudnessMeter::truePeak() const
+{
+    if (m_truePeak <= 0.0) {
+        return ABSOLUTE_GATE;
+    }
+    return qMax(ABSOLUTE_GATE, 20.0 * std::log10(m_truePeak));
+}
+
+LoudnessMeasurement LoudnessMeter::measurement() const
+{
+    LoudnessMeasurement result;
+    result.momentaryLoudness = momentaryLoudness();
+    result.shortTermLoudness = shortTermLoudness();
+    result.integratedLoudness = integratedLoudness();
+    result.loudnessRange = loudnessRange();
+    result.truePeak = truePeak();
+    result.integratedDuration = m_integratedSubBlocks * (m_subBlockFrames / static_cast<double>(m_sampleRate));
+    return result;
+}
+
+QJsonObject LoudnessMeter::toJson() const
+{
+    const LoudnessMeasurement result = measurement();
+
+    QJsonObject json;
+    json["momentary_loudness"] = result.momentaryLoudness;
+    json["short_term_loudness"] = result.shortTermLoudness;
+    json["integrated_loudness"] = result.integratedLoudness;
+    json["loudness_range"] = result.loudnessRange;
+    json["true_peak"] = result.truePeak;
+    json["integrated_duration"] = result.integratedDuration;
+    return json;
+}
+
+double LoudnessMeter::energyToLoudness(double energy)
+{
+    if (energy <= 0.0) {
+        return -HUGE_VAL;
+    }
+    return -0.691 + 10.0 * std::log10(energy);
+}
+
+// GatingHistogram
+
+void LoudnessMeter::GatingHistogram::add(double blockEnergy, double loudness)
+{
+    const int bin = binForLoudness(loudness);
+    counts[bin]++;
+    energy[bin] += blockEnergy;
+    total++;
+}
+
+void LoudnessMeter::GatingHistogram::clear()
+{
+    counts.fill(0);
+    energy.fill(0.0);
+    total = 0;
+}
+
+int LoudnessMeter::GatingHistogram::binForLoudness(double loudness) const
+{
+    if (!(loudness > ABSOLUTE_GATE)) {
+        return 0;
+    }
+    const int bin = static_cast<int>((loudness - ABSOLUTE_GATE) / HISTOGRAM_STEP);
+    return qMin(bin, HISTOGRAM_BINS - 1);
+}
+
+} // namespace LegacyStream
@@ -0,0 +1,531 @@
+#include "streaming/Resampler.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtMath>
+#include <cmath>
+#include <numeric>
+
+namespace LegacyStream {
+
+/**
+ * @brief Immutable polyphase coefficient table
+ *
+ * Each phase is stored time-reversed so that it lines up with a contiguous
+ * run of planar history ending at the newest input frame.
+ */
+struct Resampler::FilterBank
+{
+    int phases = 1;
+    int taps = 0;
+    std::vector<float> coefficients; // phases * taps
+
+    const float* phase(int index) const { return coefficients.data() + static_cast<size_t>(index) * taps; }
+};
+
+namespace {
+
+constexpr double KAISER_BETA = 8.6;   // ~85 dB stopband
+constexpr double PASSBAND_ROLLOFF = 0.92;
+
+double besselI0(double x)
+{
+    // Power series; converges quickly for the beta range used here
+    double sum = 1.0;
+    double term = 1.0;
+    const double half = x / 2.0;
+    for (int k = 1; k < 50; ++k) {
+        term *= (half / k) * (half / k);
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+int tapsForRatio(int baseTaps, qint64 upFactor, qint64 downFactor)
+{
+    // Downsampling lowers the cutoff, so the kernel spans more input frames
+    const double ratio = static_cast<double>(downFactor) / upFactor;
+    const int taps = static_cast<int>(std::ceil(baseTaps * qMax(1.0, ratio)));
+    return (taps + 3) & ~3;
+}
+
+} // namespace
+
+Resampler::Resampler()
+{
+    configure(PcmFormat(), PcmFormat());
+}
+
+Resampler::Resampler(const PcmFormat& input, const PcmFormat& output, int taps)
+{
+    configure(input, output, taps);
+}
+
+Resampler::~Resampler() = default;
+
+bool Resampler::configure(const PcmFormat& input, const PcmFormat& output, int taps)
+{
+    auto validDepth = [](int bits) { return bits == 8 || bits == 16 || bits == 24 || bits == 32; };
+    if (input.sampleRate <= 0 || output.sampleRate <= 0 ||
+        input.channels < 1 || input.channels > MAX_CHANNELS ||
+        output.channels < 1 || output.channels > MAX_CHANNELS ||
+        !validDepth(input.bitDepth) || !validDepth(output.bitDepth)) {
+        return false;
+    }
+
+    m_input = input;
+    m_output = output;
+    m_processChannels = qMin(input.channels, output.channels);
+
+    const qint64 divisor = std::gcd(static_cast<qint64>(input.sampleRate), static_cast<qint64>(output.sampleRate));
+    m_upFactor = output.sampleRate / divisor;
+    m_downFactor = input.sampleRate / divisor;
+
+    m_bank.reset();
+    if (m_upFactor != m_downFactor) {
+        m_bank = filterBank(static_cast<int>(m_upFactor), static_cast<int>(m_downFactor), taps);
+    }
+
+    buildChannelMatrices();
+    reset();
+    return true;
+}
+
+void Resampler::reset()
+{
+    m_pending.clear();
+    m_planes.assign(m_processChannels, std::vector<float>());
+
+    if (m_bank) {
+        // Zero history in front of the first frame, and start half a kernel
+        // in so output frame 0 lines up with input frame 0
+        const int taps = m_bank->taps;
+        for (auto& plane : m_planes) {
+            plane.assign(taps - 1, 0.0f);
+        }
+        m_time = static_cast<qint64>(taps - 1 + taps / 2) * m_upFactor;
+    } else {
+        m_time = 0;
+    }
+}
+
+int Resampler::latencyFrames() const
+{
+    return m_bank ? m_bank->taps / 2 : 0;
+}
+
+void Resampler::buildChannelMatrices()
+{
+    const int in = m_input.channels;
+    const int out = m_output.channels;
+    const int proc = m_processChannels;
+
+    m_downmix.clear();
+    m_upmix.clear();
+
+    if (in > proc) {
+        m_downmix.assign(static_cast<size_t>(proc) * in, 0.0f);
+        if (proc == 1) {
+            for (int c = 0; c < in; ++c) {
+                m_downmix[c] = 1.0f / in;
+            }
+        } else if (proc == 2) {
+            // ITU-style fold-down assuming L R C [LFE] Ls Rs ordering
+            const float centre = 0.7071f;
+            m_downmix[0 * in + 0] = 1.0f;
+            m_downmix[1 * in + 1] = 1.0f;
+            for (int c = 2; c < in; ++c) {
+                if (c == 2) {
+                    m_downmix[0 * in + c] = centre;
+                    m_downmix[1 * in + c] = centre;
+                } else if (c == 3 && in >= 6) {
+                    continue; // LFE is dropped
+                } else {
+                    m_downmix[(c % 2) * in + c] = centre;
+                }
+            }
+            for (int row = 0; row < 2; ++row) {
+                float sum = 0.0f;
+                for (int c = 0; c < in; ++c) {
+                    sum += m_downmix[row * in + c];
+                }
+                for (int c = 0; c < in; ++c) {
+                    m_downmix[row * in + c] /= sum;
+                }
+            }
+        } else {
+            for (int c = 0; c < proc; ++c) {
+                m_downmix[c * in + c] = 1.0f;
+            }
+        }
+    }
+
+    if (out > proc) {
+        m_upmix.assign(static_cast<size_t>(out) * proc, 0.0f);
+        if (proc == 1) {
+            m_upmix[0] = 1.0f;
+            m_upmix[1] = 1.0f; // out >= 2
+        } else {
+            for (int c = 0; c < proc; ++c) {
+                m_upmix[c * proc + c] = 1.0f;
+            }
+        }
+    }
+}
+
+std::shared_ptr<const Resampler::FilterBank> Resampler::filterBank(int upFactor, int downFactor, int taps)
+{
+    const int kernelTaps = tapsForRatio(taps, upFactor, downFactor);
+    const quint64 key = (static_cast<quint64>(upFactor) << 40) |
+                        (static_cast<quint64>(downFactor) << 16) |
+                        static_cast<quint64>(kernelTaps);
+
+    // Banks are immutable once built and shared by every stream using the ratio
+    static QMutex mutex;
+    static QHash<quint64, std::shared_ptr<const FilterBank>> cache;
+
+    QMutexLocker locker(&mutex);
+    auto it = cache.constFind(key);
+    if (it != cache.constEnd()) {
+        return it.value();
+    }
+
+    std::shared_ptr<const FilterBank> bank = designFilterBank(upFactor, downFactor, kernelTaps);
+    cache.insert(key, bank);
+    return bank;
+}
+
+std::shared_ptr<Resampler::FilterBank> Resampler::designFilterBank(int upFactor, int downFactor, int taps)
+{
+    auto bank = std::make_shared<FilterBank>();
+    bank->phases = qMin(upFactor, MAX_PHASES);
+    bank->taps = taps;
+
+    const int phases = bank->phases;
+    const qint64 length = static_cast<qint64>(phases) * taps;
+    // Centre on a whole input frame so the group delay is exactly taps / 2
+    const double centre = static_cast<double>(taps / 2) * phases;
+    const double cutoff = 0.5 * qMin(1.0, static_cast<double>(upFactor) / downFactor) * PASSBAND_ROLLOFF / phases;
+    const double windowNorm = besselI0(KAISER_BETA);
+
+    bank->coefficients.assign(static_cast<size_t>(length), 0.0f);
+
+    for (int p = 0; p < phases; ++p) {
+        float* phase = bank->coefficients.data() + static_cast<size_t>(p) * taps;
+        double sum = 0.0;
+
+        for (int j = 0; j < taps; ++j) {
+            const qint64 i = p + static_cast<qint64>(j) * phases;
+            const double x = i - centre;
+            const double arg = 2.0 * cutoff * x;
+            const double sinc = (qAbs(arg) < 1e-12) ? 1.0 : std::sin(M_PI * arg) / (M_PI * arg);
+            const double r = x / centre;
+            const double window = besselI0(KAISER_BETA * std::sqrt(qMax(0.0, 1.0 - r * r))) / windowNorm;
+            const double h = 2.0 * cutoff * sinc * window;
+
+            phase[taps - 1 - j] = static_cast<float>(h);
+            sum += h;
+        }
+
+        // Unity DC gain per phase avoids phase-dependent ripple at the output
+        if (sum != 0.0) {
+            for (int j = 0; j < taps; ++j) {
+                phase[j] = static_cast<float>(phase[j] / sum);
+            }
+        }
+    }
+
+    return bank;
+}
+
+void Resampler::precomputeCommonRatios(int taps)
+{
+    static const int pairs[][2] = {
+        {44100, 48000}, {48000, 44100}, {48000, 32000}, {48000, 22050}
+    };
+
+    for (const auto& pair : pairs) {
+        const int divisor = std::gcd(pair[0], pair[1]);
+        filterBank(pair[1] / divisor, pair[0] / divisor, taps);
+    }
+}
+
+QByteArray Resampler::process(const QByteArray& input)
+{
+    if (isPassthrough()) {
+        return input;
+    }
+
+    QByteArray output;
+    process(input.constData(), input.size(), output);
+    return output;
+}
+
+void Resampler::process(const char* input, qint64 bytes, QByteArray& output)
+{
+    const int frameBytes = m_input.bytesPerFrame();
+
+    // Complete a frame split across the previous call
+    if (!m_pending.isEmpty()) {
+        const qint64 take = qMin<qint64>(frameBytes - m_pending.size(), bytes);
+        m_pending.append(input, static_cast<int>(take));
+        input += take;
+        bytes -= take;
+        if (m_pending.size() < frameBytes) {
+            return;
+        }
+        const QByteArray frame = m_pending;
+        m_pending.clear();
+        process(frame.constData(), frameBytes, output);
+    }
+
+    const qint64 frames = bytes / frameBytes;
+    const qint64 remainder = bytes - frames * frameBytes;
+
+    if (frames > 0) {
+        if (m_bank) {
+            decodeFrames(input, frames);
+            runFilter(output);
+        } else {
+            convertDirect(input, frames, output);
+        }
+    }
+
+    if (remainder > 0) {
+        m_pending = QByteArray(input + frames * frameBytes, static_cast<int>(remainder));
+    }
+}
+
+QByteArray Resampler::flush()
+{
+    QByteArray output;
+    if (m_bank) {
+        // Push the tail of the kernel out with silence
+        for (auto& plane : m_planes) {
+            plane.insert(plane.end(), m_bank->taps / 2, 0.0f);
+        }
+        runFilter(output);
+    }
+    reset();
+    return output;
+}
+
+QByteArray Resampler::convert(const QByteArray& input, const PcmFormat& from, const PcmFormat& to)
+{
+    if (from == to || input.isEmpty()) {
+        return input;
+    }
+
+    Resampler resampler;
+    if (!resampler.configure(from, to)) {
+        return input;
+    }
+
+    QByteArray output = resampler.process(input);
+    output.append(resampler.flush());
+    return output;
+}
+
+void Resampler::decodeFrames(const char* input, qint64 frames)
+{
+    const int inChannels = m_input.channels;
+    const int sampleBytes = m_input.bitDepth / 8;
+    const bool mixing = !m_downmix.empty();
+
+    for (auto& plane : m_planes) {
+        plane.reserve(plane.size() + frames);
+    }
+
+    float frame[MAX_CHANNELS];
+    for (qint64 i = 0; i < frames; ++i) {
+        for (int c = 0; c < inChannels; ++c) {
+            frame[c] = readSample(input, m_input.bitDepth);
+            input += sampleBytes;
+        }
+
+        if (mixing) {
+            for (int pc = 0; pc < m_processChannels; ++pc) {
+                const float* row = m_downmix.data() + pc * inChannels;
+                float value = 0.0f;
+                for (int c = 0; c < inChannels; ++c) {
+                    value += row[c] * frame[c];
+                }
+                m_planes[pc].push_back(value);
+            }
+        } else {
+            for (int c = 0; c < m_processChannels; ++c) {
+                m_planes[c].push_back(frame[c]);
+            }
+        }
+    }
+}
+
+void Resampler::runFilter(QByteArray& output)
+{
+    const FilterBank& bank = *m_bank;
+    const int taps = bank.taps;
+    const qint64 available = static_cast<qint64>(m_planes[0].size());
+    const qint64 limit = available * m_upFactor;
+
+    if (m_time < limit) {
+        const qint64 outFrames = (limit - m_time + m_downFactor - 1) / m_downFactor;
+        const int outFrameBytes = m_output.bytesPerFrame();
+        const int start = output.size();
+        output.resize(start + static_cast<int>(outFrames * outFrameBytes));
+        char* out = output.data() + start;
+
+        float values[MAX_CHANNELS];
+        for (qint64 k = 0; k < outFrames; ++k) {
+            const qint64 newest = m_time / m_upFactor;
+            qint64 phase = m_time % m_upFactor;
+            if (bank.phases != m_upFactor) {
+                phase = phase * bank.phases / m_upFactor;
+            }
+            const float* h = bank.phase(static_cast<int>(phase));
+
+            for (int c = 0; c < m_processChannels; ++c) {
+                const float* x = m_planes[c].data() + (newest - taps + 1);
+                float acc = 0.0f;
+                for (int j = 0; j < taps; ++j) {
+                    acc += h[j] * x[j];
+                }
+                values[c] = acc;
+            }
+
+            encodeFrame(values, out);
+            m_time += m_downFactor;
+        }
+    }
+
+    // Keep just enough history for the next output frame
+    const qint64 drop = qBound<qint64>(0, m_time / m_upFactor - (taps - 1), available);
+    if (drop > 0) {
+        for (auto& plane : m_planes) {
+            plane.erase(plane.begin(), plane.begin() + drop);
+        }
+        m_time -= drop * m_upFactor;
+    }
+}
+
+void Resampler::convertDirect(const char* input, qint64 frames, QByteArray& output) const
+{
+    const int inChannels = m_input.channels;
+    const int sampleBytes = m_input.bitDepth / 8;
+    const int start = output.size();
+    output.resize(start + static_cast<int>(frames * m_output.bytesPerFrame()));
+    char* out = output.data() + start;
+
+    float frame[MAX_CHANNELS];
+    float values[MAX_CHANNELS];
+    for (qint64 i = 0; i < frames; ++i) {
+        for (int c = 0; c < inChannels; ++c) {
+            frame[c] = readSample(input, m_input.bitDepth);
+            input += sampleBytes;
+        }
+
+        if (!m_downmix.empty()) {
+            for (int pc = 0; pc < m_processChannels; ++pc) {
+                const float* row = m_downmix.data() + pc * inChannels;
+                float value = 0.0f;
+                for (int c = 0; c < inChannels; ++c) {
+                    value += row[c] * frame[c];
+                }
+                values[pc] = value;
+            }
+            encodeFrame(values, out);
+        } else {
+            encodeFrame(frame, out);
+        }
+    }
+}
+
+void Resampler::encodeFrame(const float* values, char*& out) const
+{
+    const int sampleBytes = m_output.bitDepth / 8;
+
+    if (m_upmix.empty()) {
+        for (int c = 0; c < m_output.channels; ++c) {
+            writeSample(out, values[c], m_output.bitDepth);
+            out += sampleBytes;
+        }
+        return;
+    }
+
+    for (int oc = 0; oc < m_output.channels; ++oc) {
+        const float* row = m_upmix.data() + oc * m_processChannels;
+        float value = 0.0f;
+        for (int pc = 0; pc < m_processChannels; ++pc) {
+            value += row[pc] * values[pc];
+        }
+        writeSample(out, value, m_output.bitDepth);
+        out += sampleBytes;
+    }
+}
+
+float Resampler::readSample(const char* p, int bitDepth)
+{
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    switch (bitDepth) {
+        case 8:
+            return (static_cast<int>(b[0]) - 128) / 128.0f;
+        case 16: {
+            const qint16 v = static_cast<qint16>(b[0] | (b[1] << 8));
+            return v / 32768.0f;
+        }
+        case 24: {
+            qint32 v = b[0] | (b[1] << 8) | (b[2] << 16);
+            if (v & 0x800000) {
+                v |= ~0xFFFFFF;
+            }
+            return v / 8388608.0f;
+        }
+        case 32: {
+            const qint32 v = static_cast<qint32>(static_cast<quint32>(b[0]) | (static_cast<quint32>(b[1]) << 8) |
+                                                 (static_cast<quint32>(b[2]) << 16) | (static_cast<quint32>(b[3]) << 24));
+            return static_cast<float>(v / 2147483648.0);
+        }
+        default:
+            return 0.0f;
+    }
+}
+
+void Resampler::writeSample(char* p, float value, int bitDepth)
+{
+    const double clamped = qBound(-1.0, static_cast<double>(value), 1.0);
+    unsigned char* b = reinterpret_cast<unsigned char*>(p);
+
+    switch (bitDepth) {
+        case 8:
+            b[0] = static_cast<unsigned char>(qBound(0, qRound(clamped * 127.0) + 128, 255));
+            break;
+        case 16: {
+            const qint16 v = static_cast<qint16>(qBound(-32768, qRound(clamped * 32767.0), 32767));
+            b[0] = static_cast<unsigned char>(v & 0xFF);
+            b[1] = static_cast<unsigned char>((v >> 8) & 0xFF);
+            break;
+        }
+        case 24: {
+            const qint32 v = qBound(-8388608, qRound(clamped * 8388607.0), 8388607);
+            b[0] = static_cast<unsigned char>(v & 0xFF);
+            b[1] = static_cast<unsigned char>((v >> 8) & 0xFF);
+            b[2] = static_cast<unsigned char>((v >> 16) & 0xFF);
+            break;
+        }
+        case 32: {
+            const qint32 v = static_cast<qint32>(qBound(-2147483648.0, std::round(clamped * 2147483647.0), 2147483647.0));
+            b[0] = static_cast<unsigned char>(v & 0xFF);
+            b[1] = static_cast<unsigned char>((v >> 8) & 0xFF);
+            b[2] = static_cast<unsigned char>((v >> 16) & 0xFF);
+            b[3] = static_cast<unsigned char>((v >> 24) & 0xFF);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+} // namespace LegacyStream
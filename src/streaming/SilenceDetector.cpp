@@ -0,0 +1,211 @@
+#include "streaming/SilenceDetector.h"
+
+#include <cmath>
+
+namespace LegacyStream {
+
+namespace {
+
+constexpr int MAX_HEADER_BYTES = 64;
+
+AudioFrameParser::Codec parserCodec(SilenceDetector::Format format)
+{
+    switch (format) {
+        case SilenceDetector::Format::MP3:
+            return AudioFrameParser::Codec::MP3;
+        case SilenceDetector::Format::AAC_ADTS:
+            return AudioFrameParser::Codec::AAC_ADTS;
+        default:
+            return AudioFrameParser::Codec::UNKNOWN;
+    }
+}
+
+} // namespace
+
+SilenceDetector::SilenceDetector(const SilenceDetectorConfig& config)
+    : m_config(config)
+{
+}
+
+void SilenceDetector::setFormat(Format format, int sampleRate, int channels)
+{
+    m_format = format;
+    m_sampleRate = qMax(1, sampleRate);
+    m_channels = qMax(1, channels);
+    reset();
+}
+
+void SilenceDetector::setConfig(const SilenceDetectorConfig& config)
+{
+    m_config = config;
+    m_config.pcmStride = qMax(1, m_config.pcmStride);
+}
+
+void SilenceDetector::reset()
+{
+    m_carry.clear();
+    m_skipBytes = 0;
+    m_pcmOddByte = false;
+    m_silentSeconds = 0.0;
+    m_audibleSeconds = 0.0;
+    m_lastLevel = 0.0;
+    m_deadAir = false;
+}
+
+SilenceDetector::Format SilenceDetector::formatForCodec(const QString& codec)
+{
+    const QString name = codec.toLower();
+    if (name == "pcm" || name == "wav" || name == "raw") {
+        return Format::PCM16;
+    }
+
+    switch (AudioFrameParser::codecFromString(name)) {
+        case AudioFrameParser::Codec::MP3:
+            return Format::MP3;
+        case AudioFrameParser::Codec::AAC_ADTS:
+            return Format::AAC_ADTS;
+        default:
+            return Format::UNSUPPORTED;
+    }
+}
+
+bool SilenceDetector::feed(const QByteArray& data)
+{
+    if (data.isEmpty() || m_format == Format::UNSUPPORTED) {
+        return false;
+    }
+
+    const bool wasDeadAir = m_deadAir;
+    if (m_format == Format::PCM16) {
+        feedPcm(data.constData(), data.size());
+    } else {
+        feedFrames(data.constData(), data.size());
+    }
+    return wasDeadAir != m_deadAir;
+}
+
+void SilenceDetector::feedPcm(const char* data, qint64 size)
+{
+    // Keep sample alignment when a chunk ends on an odd byte
+    qint64 offset = m_pcmOddByte ? 1 : 0;
+    m_pcmOddByte = ((size - offset) & 1) != 0;
+
+    const qint16* samples = reinterpret_cast<const qint16*>(data + offset);
+    const qint64 count = (size - offset) / 2;
+    if (count <= 0) {
+        return;
+    }
+
+    double sum = 0.0;
+    qint64 examined = 0;
+    for (qint64 i = 0; i < count; i += m_config.pcmStride) {
+        const double v = samples[i] / 32768.0;
+        sum += v * v;
+        ++examined;
+    }
+
+    const double meanSquare = sum / qMax<qint64>(1, examined);
+    m_lastLevel = meanSquare > 0.0 ? 10.0 * std::log10(meanSquare) : -120.0;
+
+    const double seconds = static_cast<double>(count) / (static_cast<double>(m_sampleRate) * m_channels);
+    account(m_lastLevel < m_config.silenceThreshold, seconds);
+}
+
+void SilenceDetector::feedFrames(const char* data, qint64 size)
+{
+    const AudioFrameParser::Codec codec = parserCodec(m_format);
+    const uchar* p = reinterpret_cast<const uchar*>(data);
+    qint64 pos = 0;
+    AudioFrameInfo frame;
+
+    // Finish skipping the body of a frame that was judged from its header
+    if (m_skipBytes > 0) {
+        const qint64 skip = qMin(m_skipBytes, size);
+        m_skipBytes -= skip;
+        pos += skip;
+    }
+
+    // A header split across chunks: join just enough bytes to parse it
+    while (!m_carry.isEmpty() && pos < size) {
+        const int carried = m_carry.size();
+        const int take = static_cast<int>(qMin<qint64>(MAX_HEADER_BYTES, size - pos));
+        QByteArray head = m_carry;
+        head.append(data + pos, take);
+
+        const auto result = AudioFrameParser::parse(codec, reinterpret_cast<const uchar*>(head.constData()),
+                                                    head.size(), frame);
+        if (result == AudioFrameParser::Result::NoSync) {
+            m_carry.remove(0, 1);
+            continue;
+        }
+        if (result == AudioFrameParser::Result::NeedMoreData) {
+            m_carry = head;
+            return;
+        }
+
+        m_carry.clear();
+        account(isSilentFrame(frame), frame.duration());
+
+        const qint64 remaining = frame.length - carried;
+        if (pos + remaining > size) {
+            m_skipBytes = pos + remaining - size;
+            return;
+        }
+        pos += remaining;
+    }
+
+    while (pos < size) {
+        const auto result = AudioFrameParser::parse(codec, p + pos, size - pos, frame);
+        if (result == AudioFrameParser::Result::NoSync) {
+            ++pos;
+            continue;
+        }
+        if (result == AudioFrameParser::Result::NeedMoreData) {
+            m_carry = QByteArray(data + pos, static_cast<int>(size - pos));
+            return;
+        }
+
+        account(isSilentFrame(frame), frame.duration());
+
+        if (pos + frame.length > size) {
+            m_skipBytes = pos + frame.length - size;
+            return;
+        }
+        pos += frame.length;
+    }
+}
+
+bool SilenceDetector::isSilentFrame(const AudioFrameInfo& frame)
+{
+    if (m_format == Format::MP3) {
+        m_lastLevel = frame.mainDataRatio;
+        return frame.mainDataRatio < m_config.reservoirThreshold;
+    }
+
+    // ADTS carries no side info; silent AAC frames are a handful of bytes
+    const qint64 payload = frame.length - frame.headerBytes;
+    m_lastLevel = static_cast<double>(payload) / qMax(1, frame.channels);
+    return payload < static_cast<qint64>(m_config.aacSilentFrameBytes) * qMax(1, frame.channels);
+}
+
+void SilenceDetector::account(bool silent, double seconds)
+{
+    if (silent) {
+        m_silentSeconds += seconds;
+        m_audibleSeconds = 0.0;
+        if (!m_deadAir && m_silentSeconds >= m_config.silenceDuration) {
+            m_deadAir = true;
+        }
+        return;
+    }
+
+    m_audibleSeconds += seconds;
+    if (!m_deadAir) {
+        m_silentSeconds = 0.0;
+    } else if (m_audibleSeconds >= m_config.recoveryDuration) {
+        m_deadAir = false;
+        m_silentSeconds = 0.0;
+    }
+}
+
+} // namespace LegacyStream
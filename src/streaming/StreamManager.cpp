@@ -1,12 +1,27 @@
 #include "streaming/StreamManager.h"
+#include "streaming/FallbackSource.h"
+#include "core/Configuration.h"
+
 #include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <atomic>
 
 namespace LegacyStream {
 
 StreamManager::StreamManager(QObject *parent)
     : QObject(parent)
     , m_isRunning(false)
+    , m_updateTimer(new QTimer(this))
+    , m_streams(std::make_shared<const StreamMap>())
 {
+    m_updateTimer->setSingleShot(false);
+    m_updateTimer->setInterval(1000);
+    connect(m_updateTimer, &QTimer::timeout, this, &StreamManager::onUpdateTimer);
+
     qDebug() << "StreamManager initialized";
 }
 
@@ -25,9 +40,505 @@ bool StreamManager::initialize()
 void StreamManager::shutdown()
 {
     qDebug() << "StreamManager: Shutting down";
+    stop();
     m_isRunning = false;
 }
 
+bool StreamManager::start()
+{
+    m_startTime = QDateTime::currentDateTime();
+    m_updateTimer->start();
+    return true;
+}
+
+void StreamManager::stop()
+{
+    m_updateTimer->stop();
+
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_ingest.begin(); it != m_ingest.end(); ++it) {
+        if (it->fallback) {
+            it->fallback->stop();
+        }
+    }
+}
+
+void StreamManager::addStream(const QString& mountPoint, const QString& codec, int bitrate)
+{
+    if (!isValidMountPoint(mountPoint)) {
+        emit streamError(mountPoint, "Invalid mount point");
+        return;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_ingest.contains(mountPoint)) {
+            return;
+        }
+
+        StreamInfo info;
+        info.mountPoint = mountPoint;
+        info.codec = codec;
+        info.bitrate = bitrate;
+        info.startTime = QDateTime::currentDateTime();
+
+        IngestState state;
+        state.detector = std::make_shared<SilenceDetector>(m_silenceConfig);
+        state.detector->setFormat(SilenceDetector::formatForCodec(codec), info.sampleRate, info.channels);
+        state.counters = std::make_shared<StreamCounters>();
+        state.counters->listeners = m_listeners.counters(mountPoint);
+        m_ingest.insert(mountPoint, state);
+        publishStream(mountPoint, info);
+    }
+
+    emit streamAdded(mountPoint);
+}
+
+void StreamManager::reconfigureStream(const QString& mountPoint, const QString& codec, int bitrate)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto record = findStream(mountPoint);
+        if (!record) {
+            return;
+        }
+
+        StreamInfo info = record->info;
+        const bool codecChanged = info.codec != codec;
+        info.codec = codec;
+        info.bitrate = bitrate;
+        info.draining = false;
+        publishStream(mountPoint, info);
+
+        IngestState& state = m_ingest[mountPoint];
+        state.drainDeadline = 0;
+        if (codecChanged) {
+            // Realign every source on the new framing; the segmenters pick
+            // the change up from the stream itself
+            const AudioFrameParser::Codec parserCodec = AudioFrameParser::codecFromString(codec);
+            for (auto it = state.sources.begin(); it != state.sources.end(); ++it) {
+                it->aligner.setCodec(parserCodec);
+            }
+            state.detector->setFormat(SilenceDetector::formatForCodec(codec), info.sampleRate, info.channels);
+        }
+    }
+
+    qDebug() << "StreamManager: Reconfigured" << mountPoint << codec << bitrate << "kbps";
+    refreshFallback(mountPoint);
+}
+
+void StreamManager::drainStream(const QString& mountPoint, int timeoutMs)
+{
+    QMutexLocker locker(&m_mutex);
+    const auto record = findStream(mountPoint);
+    if (!record || record->info.draining) {
+        return;
+    }
+
+    StreamInfo info = record->info;
+    info.draining = true;
+    publishStream(mountPoint, info);
+    m_ingest[mountPoint].drainDeadline = QDateTime::currentMSecsSinceEpoch() + qMax(0, timeoutMs);
+
+    qDebug() << "StreamManager: Draining" << mountPoint << "with" << currentInfo(*record).listeners << "listeners";
+}
+
+void StreamManager::refreshFallback(const QString& mountPoint)
+{
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, mountPoint]() { refreshFallback(mountPoint); }, Qt::QueuedConnection);
+        return;
+    }
+
+    FallbackSource* source = nullptr;
+    int bitrate = 128;
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto record = findStream(mountPoint);
+        if (!record || !record->info.fallbackActive) {
+            return; // the next activation resolves the file anew
+        }
+        source = m_ingest.value(mountPoint).fallback;
+        bitrate = record->info.bitrate;
+    }
+
+    const QString fileName = resolveFallbackFile(mountPoint);
+    if (!source || fileName.isEmpty() || source->fileName() == QFileInfo(fileName).canonicalFilePath()) {
+        return;
+    }
+
+    // Listeners stay on the fallback and simply hear the new file
+    if (source->open(fileName)) {
+        source->start(bitrate);
+        qDebug() << "StreamManager: Fallback on" << mountPoint << "switched to" << fileName;
+    }
+}
+
+void StreamManager::removeStream(const QString& mountPoint)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto record = findStream(mountPoint);
+        if (!record) {
+            return;
+        }
+
+        if (record->info.active) {
+            --m_activeStreams;
+        }
+        unpublishStream(mountPoint);
+
+        const IngestState state = m_ingest.take(mountPoint);
+        if (state.fallback) {
+            state.fallback->deleteLater();
+        }
+    }
+
+    emit streamRemoved(mountPoint);
+}
+
+void StreamManager::setStreamActive(const QString& mountPoint, bool active)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto record = findStream(mountPoint);
+        if (!record || record->info.active == active) {
+            return;
+        }
+
+        StreamInfo info = record->info;
+        info.active = active;
+        publishStream(mountPoint, info);
+        m_activeStreams += active ? 1 : -1;
+
+        IngestState& state = m_ingest[mountPoint];
+        state.lastDataTime = QDateTime::currentMSecsSinceEpoch();
+        state.stalled = false;
+        if (active) {
+            state.detector->reset();
+        }
+    }
+
+    if (active) {
+        emit streamConnected(mountPoint);
+    } else {
+        emit streamDisconnected(mountPoint);
+        activateFallback(mountPoint, "disconnected");
+    }
+}
+
+void StreamManager::processStreamData(const QString& mountPoint, const QByteArray& data)
+{
+    processSourceData(mountPoint, QString(), data);
+}
+
+void StreamManager::attachSource(const QString& mountPoint, const QString& sourceId, int priority)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_ingest.find(mountPoint);
+    if (it != m_ingest.end()) {
+        addSourceSlot(mountPoint, *it, sourceId, priority);
+    }
+}
+
+void StreamManager::detachSource(const QString& mountPoint, const QString& sourceId)
+{
+    bool needFallback = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_ingest.find(mountPoint);
+        if (it == m_ingest.end() || !it->sources.contains(sourceId)) {
+            return;
+        }
+
+        it->sources.remove(sourceId);
+        if (it->hasActiveSource && it->activeSource == sourceId) {
+            it->hasActiveSource = false;
+            it->activeSource.clear();
+            needFallback = !promoteStandby(*it);
+        }
+    }
+
+    // A standby source cuts over on its next frame; otherwise cover the gap
+    if (needFallback) {
+        activateFallback(mountPoint, "disconnected");
+    }
+}
+
+QString StreamManager::getActiveSource(const QString& mountPoint) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_ingest.value(mountPoint).activeSource;
+}
+
+void StreamManager::processSourceData(const QString& mountPoint, const QString& sourceId, const QByteArray& data)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+
+    QByteArray frames;
+    QString previousSource;
+    bool handover = false;
+    bool deadAirChanged = false;
+    bool deadAir = false;
+    bool fallbackActive = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_ingest.find(mountPoint);
+        if (it == m_ingest.end()) {
+            return;
+        }
+        updateStreamStatistics(mountPoint, data.size());
+
+        // Callers that never attach get an implicit priority 0 source
+        if (!it->sources.contains(sourceId)) {
+            addSourceSlot(mountPoint, *it, sourceId, 0);
+        }
+
+        // Both sides are frame aligned, so the switch lands between whole
+        // frames: the old source's partial frame is never sent and the new
+        // one starts on a header
+        SourceSlot& slot = it->sources[sourceId];
+        frames = slot.aligner.push(data);
+        if (!it->hasActiveSource || it->activeSource != sourceId) {
+            if (frames.isEmpty() || !slot.takeover) {
+                return; // standby sources only keep their aligner in sync
+            }
+            previousSource = it->activeSource;
+            cutOver(*it, sourceId);
+            handover = true;
+        }
+        if (frames.isEmpty()) {
+            return;
+        }
+
+        it->lastDataTime = QDateTime::currentMSecsSinceEpoch();
+        it->stalled = false;
+        deadAirChanged = it->detector->feed(frames);
+        deadAir = it->detector->isDeadAir();
+        fallbackActive = findStream(mountPoint)->info.fallbackActive;
+    }
+
+    if (handover) {
+        qDebug() << "StreamManager: Handover on" << mountPoint << "from" << previousSource << "to" << sourceId;
+        emit sourceHandover(mountPoint, previousSource, sourceId);
+    }
+
+    if (deadAir) {
+        if (deadAirChanged) {
+            qWarning() << "StreamManager: Dead air on" << mountPoint;
+            activateFallback(mountPoint, "silence");
+        }
+        // Keep forwarding the live source when no fallback could be started
+        if (isFallbackActive(mountPoint)) {
+            return;
+        }
+    } else if (fallbackActive) {
+        deactivateFallback(mountPoint);
+    }
+
+    emit streamDataReceived(mountPoint, frames);
+}
+
+void StreamManager::addSourceSlot(const QString& mountPoint, IngestState& state, const QString& sourceId, int priority)
+{
+    // Called with m_mutex held
+    SourceSlot slot;
+    slot.priority = priority;
+    slot.aligner.setCodec(AudioFrameParser::codecFromString(findStream(mountPoint)->info.codec));
+    slot.attachTime = QDateTime::currentMSecsSinceEpoch();
+    slot.takeover = !state.hasActiveSource || priority >= state.activePriority;
+    state.sources.insert(sourceId, slot);
+
+    qDebug() << "StreamManager: Source" << sourceId << "attached to" << mountPoint
+             << "priority" << priority << (slot.takeover ? "(taking over)" : "(standby)");
+}
+
+void StreamManager::cutOver(IngestState& state, const QString& sourceId)
+{
+    // Called with m_mutex held. Listeners follow the mount, not the source,
+    // so switching the active source id is the whole cutover.
+    if (state.hasActiveSource && state.sources.contains(state.activeSource)) {
+        SourceSlot& previous = state.sources[state.activeSource];
+        previous.aligner.reset();
+        previous.takeover = false;
+    }
+
+    SourceSlot& slot = state.sources[sourceId];
+    slot.takeover = false;
+    state.activeSource = sourceId;
+    state.activePriority = slot.priority;
+    state.hasActiveSource = true;
+    state.detector->reset();
+}
+
+bool StreamManager::promoteStandby(IngestState& state)
+{
+    // Called with m_mutex held. Highest priority wins, then the newest.
+    auto best = state.sources.end();
+    for (auto it = state.sources.begin(); it != state.sources.end(); ++it) {
+        if (state.hasActiveSource && it.key() == state.activeSource) {
+            continue;
+        }
+        if (best == state.sources.end() || it->priority > best->priority ||
+            (it->priority == best->priority && it->attachTime > best->attachTime)) {
+            best = it;
+        }
+    }
+
+    if (best == state.sources.end()) {
+        return false;
+    }
+    best->takeover = true;
+    return true;
+}
+
+void StreamManager::setSilenceDetectorConfig(const SilenceDetectorConfig& config)
+{
+    QMutexLocker locker(&m_mutex);
+    m_silenceConfig = config;
+    for (auto it = m_ingest.begin(); it != m_ingest.end(); ++it) {
+        it->detector->setConfig(config);
+    }
+}
+
+void StreamManager::setStallTimeout(int milliseconds)
+{
+    QMutexLocker locker(&m_mutex);
+    m_stallTimeout = qMax(500, milliseconds);
+}
+
+bool StreamManager::isFallbackActive(const QString& mountPoint) const
+{
+    // Asked for every chunk, so a snapshot read rather than the lock
+    const auto record = findStream(mountPoint);
+    return record && record->info.fallbackActive;
+}
+
+QString StreamManager::resolveFallbackFile(const QString& mountPoint) const
+{
+    const Configuration& config = Configuration::instance();
+    const QStringList candidates = {
+        config.getMountPointFallbackFile(mountPoint),
+        config.fallbackFile(),
+        config.emergencyFile()
+    };
+
+    for (const QString& fileName : candidates) {
+        if (!fileName.isEmpty() && QFile::exists(fileName)) {
+            return fileName;
+        }
+    }
+    return QString();
+}
+
+void StreamManager::activateFallback(const QString& mountPoint, const QString& reason)
+{
+    // Fallback sources own timers, so they are driven from our own thread
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, mountPoint, reason]() {
+            activateFallback(mountPoint, reason);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    if (!Configuration::instance().fallbackEnabled()) {
+        return;
+    }
+
+    const QString fileName = resolveFallbackFile(mountPoint);
+    if (fileName.isEmpty()) {
+        qWarning() << "StreamManager: No fallback file for" << mountPoint;
+        return;
+    }
+
+    FallbackSource* source = nullptr;
+    int bitrate = 128;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_ingest.find(mountPoint);
+        const auto record = findStream(mountPoint);
+        if (it == m_ingest.end() || !record || record->info.fallbackActive) {
+            return;
+        }
+
+        if (!it->fallback) {
+            it->fallback = new FallbackSource(this);
+            connect(it->fallback, &FallbackSource::dataReady, this, [this, mountPoint](const QByteArray& data) {
+                // Guard against a tick racing a source that just came back
+                if (isFallbackActive(mountPoint)) {
+                    emit streamDataReceived(mountPoint, data);
+                }
+            });
+            connect(it->fallback, &FallbackSource::error, this, [this, mountPoint](const QString& error) {
+                emit streamError(mountPoint, error);
+            });
+        }
+
+        StreamInfo info = record->info;
+        info.fallbackActive = true;
+        info.fallbackReason = reason;
+        publishStream(mountPoint, info);
+        source = it->fallback;
+        bitrate = info.bitrate;
+    }
+
+    // The source emits its first chunk from start(), so the lock is released
+    if ((source->fileName() != QFileInfo(fileName).canonicalFilePath() || !source->isOpen()) &&
+        !source->open(fileName)) {
+        QMutexLocker locker(&m_mutex);
+        if (const auto record = findStream(mountPoint)) {
+            StreamInfo info = record->info;
+            info.fallbackActive = false;
+            info.fallbackReason.clear();
+            publishStream(mountPoint, info);
+        }
+        return;
+    }
+    source->start(bitrate);
+
+    qDebug() << "StreamManager: Fallback" << fileName << "on" << mountPoint << "(" << reason << ")";
+    emit fallbackActivated(mountPoint, fileName, reason);
+}
+
+void StreamManager::deactivateFallback(const QString& mountPoint)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto record = findStream(mountPoint);
+        if (!record || !record->info.fallbackActive) {
+            return;
+        }
+
+        // Flip the flag first: listeners switch back on the next live chunk
+        StreamInfo info = record->info;
+        info.fallbackActive = false;
+        info.fallbackReason.clear();
+        publishStream(mountPoint, info);
+
+        FallbackSource* source = m_ingest.value(mountPoint).fallback;
+        if (source) {
+            QMetaObject::invokeMethod(source, &FallbackSource::stop, Qt::QueuedConnection);
+        }
+    }
+
+    qDebug() << "StreamManager: Live source restored on" << mountPoint;
+    emit fallbackDeactivated(mountPoint);
+}
+
+void StreamManager::updateStreamStatistics(const QString& mountPoint, qint64 bytesReceived)
+{
+    // Called with m_mutex held; the counters need no copy of the record
+    m_ingest[mountPoint].counters->bytesReceived.fetch_add(bytesReceived, std::memory_order_relaxed);
+    m_totalBytesReceived.fetch_add(bytesReceived, std::memory_order_relaxed);
+}
+
+bool StreamManager::isValidMountPoint(const QString& mountPoint) const
+{
+    return mountPoint.startsWith('/') && mountPoint.length() > 1 && !mountPoint.contains("..");
+}
+
 bool StreamManager::isRunning() const
 {
     return m_isRunning;
@@ -38,9 +549,197 @@ int StreamManager::getActiveStreamCount() const
     return m_activeStreams;
 }
 
+std::shared_ptr<const StreamManager::StreamRecord> StreamManager::findStream(const QString& mountPoint) const
+{
+    return std::atomic_load(&m_streams)->value(mountPoint);
+}
+
+StreamInfo StreamManager::currentInfo(const StreamRecord& record) const
+{
+    StreamInfo info = record.info;
+    info.bytesReceived = record.counters->bytesReceived.load(std::memory_order_relaxed);
+    if (record.counters->listeners) {
+        info.listeners = record.counters->listeners->listeners.load(std::memory_order_relaxed);
+        info.bytesSent = record.counters->listeners->bytesSent.load(std::memory_order_relaxed);
+    }
+    return info;
+}
+
+void StreamManager::publishStream(const QString& mountPoint, const StreamInfo& info)
+{
+    // Called with m_mutex held, which serialises writers. Mounts change
+    // rarely, so copying the map per change is cheap next to the reads.
+    const std::shared_ptr<const StreamMap> current = std::atomic_load(&m_streams);
+    auto next = std::make_shared<StreamMap>(*current);
+
+    auto record = std::make_shared<StreamRecord>();
+    record->info = info;
+    record->counters = m_ingest.value(mountPoint).counters;
+    next->insert(mountPoint, std::move(record));
+
+    std::atomic_store(&m_streams, std::shared_ptr<const StreamMap>(std::move(next)));
+}
+
+void StreamManager::unpublishStream(const QString& mountPoint)
+{
+    // Called with m_mutex held
+    auto next = std::make_shared<StreamMap>(*std::atomic_load(&m_streams));
+    next->remove(mountPoint);
+    std::atomic_store(&m_streams, std::shared_ptr<const StreamMap>(std::move(next)));
+}
+
+void StreamManager::updateStream(const QString& mountPoint, const StreamInfo& info)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto record = findStream(mountPoint);
+        if (!record) {
+            return;
+        }
+
+        // Descriptive fields only; state and counters stay ours
+        StreamInfo updated = info;
+        updated.mountPoint = mountPoint;
+        updated.active = record->info.active;
+        updated.startTime = record->info.startTime;
+        updated.fallbackActive = record->info.fallbackActive;
+        updated.fallbackReason = record->info.fallbackReason;
+        publishStream(mountPoint, updated);
+    }
+    emit statusChanged(getStatusJson());
+}
+
+void StreamManager::setStreamMetadata(const QString& mountPoint, const QString& metadata)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto record = findStream(mountPoint);
+        if (!record || record->info.metadata == metadata) {
+            return;
+        }
+
+        StreamInfo info = record->info;
+        info.metadata = metadata;
+        publishStream(mountPoint, info);
+    }
+    emit streamMetadataUpdated(mountPoint, metadata);
+}
+
+bool StreamManager::hasStream(const QString& mountPoint) const
+{
+    return std::atomic_load(&m_streams)->contains(mountPoint);
+}
+
+QList<StreamInfo> StreamManager::getStreams() const
+{
+    const std::shared_ptr<const StreamMap> snapshot = std::atomic_load(&m_streams);
+    QList<StreamInfo> streams;
+    streams.reserve(snapshot->size());
+    for (const auto& record : *snapshot) {
+        streams.append(currentInfo(*record));
+    }
+    return streams;
+}
+
+StreamInfo StreamManager::getStreamInfo(const QString& mountPoint) const
+{
+    const auto record = findStream(mountPoint);
+    return record ? currentInfo(*record) : StreamInfo();
+}
+
+QJsonArray StreamManager::getStreamsJson() const
+{
+    QJsonArray streams;
+    for (const StreamInfo& info : getStreams()) {
+        QJsonObject stream;
+        stream["mountPoint"] = info.mountPoint;
+        stream["codec"] = info.codec;
+        stream["bitrate"] = info.bitrate;
+        stream["sampleRate"] = info.sampleRate;
+        stream["channels"] = info.channels;
+        stream["active"] = info.active;
+        stream["bytesReceived"] = info.bytesReceived;
+        stream["bytesSent"] = info.bytesSent;
+        stream["listeners"] = info.listeners;
+        stream["startTime"] = info.startTime.toString(Qt::ISODate);
+        stream["metadata"] = info.metadata;
+        stream["fallbackActive"] = info.fallbackActive;
+        stream["fallbackReason"] = info.fallbackReason;
+        stream["draining"] = info.draining;
+        streams.append(stream);
+    }
+    return streams;
+}
+
+QJsonObject StreamManager::getStatusJson() const
+{
+    QJsonObject status;
+    status["running"] = isRunning();
+    status["activeStreams"] = getActiveStreams();
+    status["totalBytesReceived"] = getTotalBytesReceived();
+    status["totalBytesSent"] = getTotalBytesSent();
+    status["totalListeners"] = getTotalListeners();
+    status["startTime"] = m_startTime.toString(Qt::ISODate);
+    status["streams"] = getStreamsJson();
+    return status;
+}
+
+qint64 StreamManager::getTotalBytesReceived() const
+{
+    return m_totalBytesReceived.load(std::memory_order_relaxed);
+}
+
+qint64 StreamManager::getTotalBytesSent() const
+{
+    return m_listeners.totalBytesSent();
+}
+
+int StreamManager::getTotalListeners() const
+{
+    return m_listeners.totalListeners();
+}
+
+int StreamManager::getActiveStreams() const
+{
+    return m_activeStreams;
+}
+
 void StreamManager::onUpdateTimer()
 {
-    // Stub implementation
+    // A source that stays connected but stops sending never trips the
+    // silence detector, so catch it by the age of its last chunk
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QStringList stalled;
+    QStringList drained;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_ingest.begin(); it != m_ingest.end(); ++it) {
+            const auto record = findStream(it.key());
+            if (it->drainDeadline > 0 &&
+                (now >= it->drainDeadline || it->counters->listeners->listeners.load(std::memory_order_relaxed) == 0)) {
+                drained << it.key();
+                continue;
+            }
+            if (!record || !record->info.active || it->stalled || it->lastDataTime == 0) {
+                continue;
+            }
+            if (now - it->lastDataTime > m_stallTimeout) {
+                it->stalled = true;
+                promoteStandby(*it);
+                stalled << it.key();
+            }
+        }
+    }
+
+    for (const QString& mountPoint : stalled) {
+        qWarning() << "StreamManager: Source stalled on" << mountPoint;
+        activateFallback(mountPoint, "stalled");
+    }
+
+    for (const QString& mountPoint : drained) {
+        qDebug() << "StreamManager: Drained" << mountPoint;
+        removeStream(mountPoint);
+    }
 }
 
-} // namespace LegacyStream 
\ No newline at end of file
+} // namespace LegacyStream
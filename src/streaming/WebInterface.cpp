@@ -1,4 +1,5 @@
 #include "streaming/WebInterface.h"
+#include "streaming/StreamManager.h"
 #include <QDebug>
 
 namespace LegacyStream {
@@ -19,9 +20,9 @@ WebInterface::~WebInterface()
 
 bool WebInterface::initialize(HttpServer* httpServer, StreamManager* streamManager, StatisticRelay::StatisticRelayManager* statisticRelayManager)
 {
-    Q_UNUSED(httpServer)
-    Q_UNUSED(streamManager)
-    Q_UNUSED(statisticRelayManager)
+    m_httpServer = httpServer;
+    m_streamManager = streamManager;
+    m_statisticRelayManager = statisticRelayManager;
     
     qDebug() << "WebInterface: Initializing";
     m_isInitialized = true;
@@ -53,21 +54,32 @@ void WebInterface::onStreamDisconnected(const QString& mountPoint)
 
 void WebInterface::onListenerConnected(const QString& mountPoint, const QString& clientIP)
 {
-    // Stub implementation
+    // Sessions are tracked by StreamManager's ListenerRegistry
     Q_UNUSED(mountPoint)
     Q_UNUSED(clientIP)
 }
 
 void WebInterface::onListenerDisconnected(const QString& mountPoint, const QString& clientIP)
 {
-    // Stub implementation
+    // Sessions are tracked by StreamManager's ListenerRegistry
     Q_UNUSED(mountPoint)
     Q_UNUSED(clientIP)
 }
 
 void WebInterface::updateStatistics()
 {
-    // Stub implementation
+    if (!m_streamManager) {
+        return;
+    }
+
+    const ListenerRegistry& registry = m_streamManager->listenerRegistry();
+    m_totalListeners = registry.totalListeners();
+    m_totalBytesServed = registry.totalBytesSent();
+    for (auto it = m_mountPoints.begin(); it != m_mountPoints.end(); ++it) {
+        it->listeners = registry.listenerCount(it.key());
+        it->peakListeners = qMax(it->peakListeners, it->listeners);
+        it->bytesServed = registry.bytesSent(it.key());
+    }
 }
 
 } // namespace WebInterface